@@ -10,7 +10,8 @@ DataSend::DataSend(
   std::shared_ptr<Command::Encoder>   encoderRArg,
   std::shared_ptr<Command::SR04>      rangeFinderArg,
   std::shared_ptr<Command::Gyro>      gyroArg,
-  std::shared_ptr<HW::I>              hwiArg
+  std::shared_ptr<HW::I>              hwiArg,
+  std::shared_ptr<Time::HST>          hstArg
 ) :
   debug { debugArg }, 
   net { netArg }, 
@@ -18,22 +19,95 @@ DataSend::DataSend(
   encoderR{ encoderRArg },
   rangeFinder{ rangeFinderArg },
   gyro{ gyroArg },
-  hwi{ hwiArg}
+  hwi{ hwiArg},
+  hst{ hstArg }
 {
 }
 
 //
 // Standard execute method
 //
+// The sensors are read once.  Each client that asked for telemetry gets
+// it as a UDP datagram if it asked for one, and down its stream (binary
+// or ASCII, whichever it speaks) otherwise.  Each format is built the
+// first time a client needs it and copied to the rest.
+//
+// 1. Nobody's listening?  Skip the formatting entirely
+// 2. Take one sample
+// 3. Fan it out
+//
 Time::TimeUS DataSend::execute() 
 {
   timesCalled++;
 
-  if ( isOutputting ) {
-    net->get() << "ENL " << encoderL->getPosition() << " " << encoderL->getSpeed() << "\n";  
-    net->get() << "ENR " << encoderR->getPosition() << " " << encoderR->getSpeed() << "\n";
-    net->get() << "RNG " << rangeFinder->getLastSensorReading() << "\n";
-    net->get() << "GYR " << gyro->getAngle() << "\n";
+  // 1. Anybody listening?
+  const size_t numConnections = net->numConnections();
+  bool anyListening = false;
+  for ( size_t i = 0; i < numConnections && !anyListening; ++i ) {
+    NetConnection& connection = net->connection( i );
+    anyListening = connection && connection.wantsTelemetry();
+  }
+
+  if ( anyListening ) {
+    // 2. One sample for everybody
+    const NetFrame::TelemetryRecord record = NetFrame::TelemetryRecord::fromSample( 
+      encoderL->getPosition(), encoderL->getSpeed(),
+      encoderR->getPosition(), encoderR->getSpeed(),
+      rangeFinder->getLastSensorReading(), gyro->getAngle() );
+
+    // The four lines at their longest have to fit, or an ASCII client gets
+    // half a line
+    using Util::maxPrintedLength;
+    using Position = decltype( encoderL->getPosition() );
+    using Speed = decltype( encoderL->getSpeed() );
+    using Range = decltype( rangeFinder->getLastSensorReading() );
+    using Angle = decltype( gyro->getAngle() );
+    constexpr size_t longestEncoder = 4 + maxPrintedLength< Position >() + 1 + maxPrintedLength< Speed >() + 1;
+    constexpr size_t longestRange = 4 + maxPrintedLength< Range >() + 1;
+    constexpr size_t longestGyro = 4 + maxPrintedLength< Angle >() + 1;
+    static_assert( 2 * longestEncoder + longestRange + longestGyro <= asciiTelemetrySize,
+                   "asciiTelemetrySize can't hold the ASCII telemetry lines" );
+
+    Util::FixedSink< asciiTelemetrySize > asciiSink;
+    uint8_t frame[ NetFrame::TelemetryRecord::frameSize ];
+    uint8_t datagram[ NetFrame::TelemetryDatagram::frameSize ];
+    bool haveAscii = false;
+    bool haveFrame = false;
+    bool haveDatagram = false;
+
+    // 3. Fan out
+    for ( size_t i = 0; i < numConnections; ++i ) {
+      NetConnection& connection = net->connection( i );
+      if ( !connection || !connection.wantsTelemetry() ) {
+        continue;
+      }
+      if ( connection.sendsTelemetryDatagrams() ) {
+        if ( !haveDatagram ) {
+          NetFrame::TelemetryDatagram packet{ datagramSequence++, 
+            static_cast<uint32_t>( hst->usSinceDeviceStart().get() ), record };
+          packet.encodeFrame( datagram );
+          haveDatagram = true;
+        }
+        connection.sendTelemetryDatagram( datagram, sizeof( datagram ));
+      }
+      else if ( connection.protocol() == NetFrame::Protocol::Binary ) {
+        if ( !haveFrame ) {
+          record.encodeFrame( frame );
+          haveFrame = true;
+        }
+        connection.telemetry().writeFrame( frame, sizeof( frame ));
+      }
+      else {
+        if ( !haveAscii ) {
+          asciiSink << "ENL " << encoderL->getPosition() << " " << encoderL->getSpeed() << "\n";  
+          asciiSink << "ENR " << encoderR->getPosition() << " " << encoderR->getSpeed() << "\n";
+          asciiSink << "RNG " << rangeFinder->getLastSensorReading() << "\n";
+          asciiSink << "GYR " << gyro->getAngle() << "\n";
+          haveAscii = true;
+        }
+        connection.telemetry().write( asciiSink.data(), asciiSink.size() );
+      }
+    }
   }
   rangeFinder->sensorRequest();
 
@@ -159,10 +233,5 @@ const char* DataSend::debugName()
   return "Data Sender";
 }
 
-void DataSend::setOutput( bool isOutputtingArg )
-{
-  isOutputting = isOutputtingArg;
-}
-
 } // End Command Namespace
 
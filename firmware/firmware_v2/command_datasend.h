@@ -9,6 +9,8 @@
 #include "debug_interface.h"
 #include "hardware_interface.h"
 #include "net_interface.h"
+#include "time_hst.h"
+#include "util_fixed_sink.h"
 
 namespace Command {
 
@@ -28,6 +30,8 @@ class DataSend: public Base {
   /// @param[in] rangeFinderArg - Interface to the SR04 range finder
   /// @param[in] gryoArg        - Interface to the Gyroscope
   /// @param[in] hwiArg         - Interface to the hardware, for LED setting
+  /// @param[in] hstArg         - Interface to the high speed timer, for
+  ///                             telemetry timestamps
   /// 
   DataSend( 
     std::shared_ptr<DebugInterface>     debugArg,
@@ -36,7 +40,8 @@ class DataSend: public Base {
     std::shared_ptr<Command::Encoder>   encoderRArg,
     std::shared_ptr<Command::SR04>      rangeFinderArg,
     std::shared_ptr<Command::Gyro>      gyroArg,
-    std::shared_ptr<HW::I>              hwiArg
+    std::shared_ptr<HW::I>              hwiArg,
+    std::shared_ptr<Time::HST>          hstArg
   );
 
   ///
@@ -53,13 +58,12 @@ class DataSend: public Base {
   ///
   virtual const char* debugName() override;
 
-  ///
-  /// @brief Start sending data every 50th of a second
-  ///
-  void setOutput( bool on );
-
   private:
 
+  // @brief Room for the four ASCII telemetry lines at their longest, 87
+  //        characters.  execute() checks it
+  static constexpr size_t asciiTelemetrySize = 96;
+
   void updateLEDs();
 
   // @brief Interface to debug log
@@ -76,8 +80,10 @@ class DataSend: public Base {
   std::shared_ptr<Gyro>   gyro;
   // @brief Interface to hardware, for setting LEDs.
   std::shared_ptr<HW::I>  hwi;
-  // @brief Are we currently outputting data
-  bool isOutputting = false;
+  // @brief Interface to the high speed timer, for telemetry timestamps
+  std::shared_ptr<Time::HST> hst;
+  // @brief Sequence number for the next UDP telemetry datagram
+  uint32_t datagramSequence = 0;
   // @brief How many times have we been called?
   unsigned int timesCalled  = 0;
   // @brief Last valid sensor reading - for LED display only.  Default = invalid
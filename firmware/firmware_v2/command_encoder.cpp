@@ -1,5 +1,6 @@
 #include "command_encoder.h"
 #include "wifi_debug_ostream.h"
+#include "util_probe.h"
 #include <cmath>
 
 namespace Command{
@@ -68,27 +69,39 @@ Time::TimeUS Encoder::execute()
 
   // ==Low==
   //(*debug) << "Starting Low " << i2cBus << "\n";
-  hwi->WireBeginTransmission(i2cBus, I2C_ADRESS);
-  hwi->WireWrite(i2cBus, _raw_ang_lo );
-  hwi->WireEndTransmission(i2cBus);
-  hwi->WireRequestFrom(i2cBus, I2C_ADRESS, 1);
-
-  while (hwi->WireAvailable(i2cBus) == 0);
+  {
+    OCTO_PROBE_SCOPE( "Encoder I2C Low" );
+    hwi->WireBeginTransmission(i2cBus, I2C_ADRESS);
+    hwi->WireWrite(i2cBus, _raw_ang_lo );
+    hwi->WireEndTransmission(i2cBus);
+    hwi->WireRequestFrom(i2cBus, I2C_ADRESS, 1);
+  }
+  {
+    OCTO_PROBE_SCOPE( "Encoder Wait Low" );
+    while (hwi->WireAvailable(i2cBus) == 0);
+  }
   low = hwi->WireRead(i2cBus);
 
   //(*debug) << "Ending Low " << i2cBus << "\n";
 
   // ==High==
   //(*debug) << "Starting High\n";
-  hwi->WireBeginTransmission(i2cBus, I2C_ADRESS);
-  hwi->WireWrite(i2cBus, _raw_ang_hi );
-  hwi->WireEndTransmission(i2cBus);
-  hwi->WireRequestFrom(i2cBus, I2C_ADRESS, 1);
-
-  while (hwi->WireAvailable(i2cBus) == 0)
-  ;
+  {
+    OCTO_PROBE_SCOPE( "Encoder I2C High" );
+    hwi->WireBeginTransmission(i2cBus, I2C_ADRESS);
+    hwi->WireWrite(i2cBus, _raw_ang_hi );
+    hwi->WireEndTransmission(i2cBus);
+    hwi->WireRequestFrom(i2cBus, I2C_ADRESS, 1);
+  }
+  {
+    OCTO_PROBE_SCOPE( "Encoder Wait High" );
+    while (hwi->WireAvailable(i2cBus) == 0)
+    ;
+  }
   high = hwi->WireRead(i2cBus);
 
+  OCTO_PROBE_SCOPE( "Encoder Math" );
+
   high = high << 8;
   const int raw_position = high | low;
 
@@ -2,15 +2,23 @@
 #include "debug_interface.h"
 #include "command_parser.h"
 #include "wifi_debug_ostream.h"
+#include "util_metrics.h"
+#include <cctype>
+#include <string_view>
 #include <vector>
 #include <algorithm>
 
 namespace CommandParser
 {
 
+namespace {
+Util::Metric unknownCommands( "Unknown Commands" );
+} // end anonymous namespace
+
   enum class HasArg {
     Yes,
-    No
+    No,
+    Optional      ///< NoArg if there isn't one
   };
 
 
@@ -28,7 +36,7 @@ class CommandTemplate
 
 const std::vector<CommandTemplate> commandTemplates =
 {
-  { "ping",       Command::Ping,          HasArg::No   },
+  { "ping",       Command::Ping,          HasArg::Optional },
   { "motorl",     Command::SetMotorL,     HasArg::Yes  },
   { "motorr",     Command::SetMotorR,     HasArg::Yes  },
   { "motora",     Command::SetMotorA,     HasArg::Yes  },
@@ -38,9 +46,15 @@ const std::vector<CommandTemplate> commandTemplates =
   { "timeus",     Command::GetTimeUs,     HasArg::No   },
   { "profile",    Command::Profile,       HasArg::No   },
   { "rprofile",   Command::RProfile,      HasArg::No   },
+  { "lateness",   Command::Lateness,      HasArg::No   },
+  { "top",        Command::Top,           HasArg::No   },
+  { "trace",      Command::Trace,         HasArg::No   },
+  { "stats",      Command::Stats,         HasArg::No   },
   { "datasend",   Command::DataSend,      HasArg::Yes  },
   { "range",      Command::RangeSensor,   HasArg::No   },
   { "gyro",       Command::ReadGyro,      HasArg::No   },
+  { "protocol",   Command::Protocol,      HasArg::Yes  },
+  { "udp",        Command::UdpTelemetry,  HasArg::Yes  },
 }; 
 
 /// @brief Process an integer argument
@@ -73,40 +87,150 @@ int process_int( const std::string& string,  size_t pos )
   return negative ? -result : result;
 }
 
+//
+// Binary mode.  A Command frame is a one byte opcode (the Command value),
+// then, if the command takes one, a 4 byte little endian argument, then
+// an optional 4 byte little endian request tag.  A command that takes an
+// argument and doesn't get one gets 0, the same as in ASCII (i.e., a bare
+// "datasend" is off).
+//
+const CommandPacket checkForBinaryCommands( NetConnection& connection )
+{
+  CommandPacket result;
+
+  while ( connection.getFrame() ) 
+  {
+    const NetFrame::Decoder& frame = connection.frame();
+    if ( frame.type() != NetFrame::Type::Command || frame.length() == 0 ||
+         frame.payload()[ 0 ] >= static_cast<uint8_t>( Command::NoCommand )) 
+    {
+      unknownCommands.increment();
+      continue;
+    }
+    result.command = static_cast<Command>( frame.payload()[ 0 ] );
+    if ( frame.length() >= 5 ) 
+    {
+      result.optionalArg = static_cast<int32_t>( NetFrame::getLE32( frame.payload() + 1 ));
+    }
+    else
+    {
+      auto ct = std::find_if( commandTemplates.begin(), commandTemplates.end(), 
+        [&result]( const CommandTemplate& t ) { return t.outputCommand == result.command; } );
+      if ( ct != commandTemplates.end() && ct->hasArg == HasArg::Yes ) 
+      {
+        result.optionalArg = 0;
+      }
+    }
+    if ( frame.length() >= 9 ) 
+    {
+      result.tag = static_cast<int32_t>( NetFrame::getLE32( frame.payload() + 5 ) & 0x7fffffff );
+    }
+    return result;
+  }
+  return result;
+}
+
 const CommandPacket checkForCommands( 
 	NetConnection& connection )
 {
-	CommandPacket result;
-  
-  // Read the first line of the request.  
-
-  static std::string command;
-  command.reserve( 256 );
-  bool dataReady = connection.getString( command );
-  if ( !dataReady )
+  if ( connection.protocol() == NetFrame::Protocol::Binary ) 
   {
-    return result;
+    return checkForBinaryCommands( connection );
   }
 
-  std::transform( command.begin(), command.end(), command.begin(), ::tolower);
+  // Blank commands (i.e., an empty line, or "ping;;ping") are skipped, so
+  // this only returns NoCommand when there's no complete line waiting.
+  for (;;)
+  {
+    CommandPacket result;
 
-  connection << "# Got: " << command << "\n";
+    // Read the first line of the request.  Each connection keeps its own
+    // partial line, so clients typing at the same time don't get mixed 
+    // up.  A line that's a ';' batch stays there until every command in 
+    // it has been handed out.
 
-  for ( const CommandTemplate& ct : commandTemplates )
-  {
-    if ( command.find(ct.inputCommand ) == 0 )
+    std::string& command = connection.commandLine();
+    size_t& batchPosition = connection.batchPosition();
+    command.reserve( 256 );
+    if ( !connection.inBatch() )
     {
-      result.command = ct.outputCommand;
-      if ( ct.hasArg == HasArg::Yes )
+      bool dataReady = connection.getString( command );
+      if ( !dataReady )
       {
-        result.optionalArg =  process_int( command,  ct.inputCommand.length()+1  );
-      } 
-      command.resize(0);
+        return result;
+      }
+      std::transform( command.begin(), command.end(), command.begin(), ::tolower);
+    }
+
+    // This command runs from start to the next ';' (or the end of the 
+    // line).  It can start with a request tag, i.e., "@42 ping"
+    size_t start = batchPosition;
+    while ( start < command.length() && command[ start ] == ' ' ) 
+    {
+      ++start;
+    }
+    if ( start < command.length() && command[ start ] == '@' ) 
+    {
+      const int tag = process_int( command, start + 1 );
+      result.tag = tag < 0 ? NoTag : tag;
+      while ( start < command.length() && command[ start ] != ' ' && command[ start ] != ';' ) 
+      {
+        ++start;
+      }
+      while ( start < command.length() && command[ start ] == ' ' ) 
+      {
+        ++start;
+      }
+    }
+    const size_t separator = command.find( ';', start );
+    const size_t end = separator == std::string::npos ? command.length() : separator;
+    const std::string_view current = std::string_view( command ).substr( start, end - start );
+    const bool blank = current.empty() && result.tag == NoTag;
+
+    if ( !blank )
+    {
+      connection << "# Got: " << current << "\n";
+    }
+
+    for ( const CommandTemplate& ct : commandTemplates )
+    {
+      if ( !current.empty() &&
+           current.substr( 0, ct.inputCommand.length() ) == ct.inputCommand )
+      {
+        result.command = ct.outputCommand;
+        const size_t argPosition = start + ct.inputCommand.length() + 1;
+        if ( ct.hasArg == HasArg::Yes )
+        {
+          result.optionalArg = argPosition <= end ? process_int( command, argPosition ) : 0;
+        } 
+        else if ( ct.hasArg == HasArg::Optional && argPosition < end &&
+                  ( isdigit( command[ argPosition ] ) || command[ argPosition ] == '-' ))
+        {
+          result.optionalArg = process_int( command, argPosition );
+        }
+        break;
+      }
+    } 
+    if ( result.command == Command::NoCommand && !blank ) {
+      result.command = Command::BadCommand;
+      unknownCommands.increment();
+    }
+
+    // Move on to the next command in the batch, or finish with the line
+    if ( separator != std::string::npos && separator + 1 < command.length() )
+    {
+      batchPosition = separator + 1;
+    }
+    else
+    {
+      connection.clearCommandLine();
+    }
+
+    if ( !blank )
+    {
       return result;
     }
-  } 
-  command.resize(0);
-  return result;
+  }
 
 }
 
@@ -11,6 +11,8 @@ namespace CommandParser {
 
   int process_int( const std::string& string,  size_t pos );
 
+  /// Binary connections send these values as the command opcode, so new
+  /// commands go at the end (just before NoCommand).
   enum class Command {
     StartOfCommands = 0,  ///<  Start of the command list
     Ping            = 0,  ///<  Send a pong
@@ -23,34 +25,48 @@ namespace CommandParser {
     GetTimeUs,            ///<  Get us since device start
     Profile,              ///<  Dump profiling data to net
     RProfile,             ///<  Reset profiling data
+    Lateness,             ///<  Dump scheduling lateness data to net
+    Top,                  ///<  Dump CPU use & budget overruns to net
+    Trace,                ///<  Dump the scheduler trace to net
+    Stats,                ///<  Dump the counters & gauges to net
     DataSend,             ///<  If arg=1, send state data 50x / sec. arg=0 stops
     RangeSensor,          ///<  Read the SR04 range sensor
     ReadGyro,             ///<  Read the GY-521 Gyrscope
+    Protocol,             ///<  arg=1 switches to binary frames, arg=0 to ASCII
+    UdpTelemetry,         ///<  Send telemetry to UDP port arg.  arg=0 stops
     NoCommand,            ///<  No command was specified.
+    BadCommand,           ///<  A command was read, but it isn't one of these
     EndOfCommands         ///<  End of the comand list.
   };
 
   constexpr int NoArg = -1;
+  constexpr int NoTag = -1;
 
   class CommandPacket  {
     public:
-    CommandPacket(): command{Command::NoCommand}, optionalArg{NoArg}
+    CommandPacket(): command{Command::NoCommand}, optionalArg{NoArg}, tag{NoTag}
     {
     }
-    CommandPacket( Command c ): command{c}, optionalArg{NoArg}
+    CommandPacket( Command c ): command{c}, optionalArg{NoArg}, tag{NoTag}
     {
     }
-    CommandPacket( Command c, int o ): command{c}, optionalArg{o}
+    CommandPacket( Command c, int o ): command{c}, optionalArg{o}, tag{NoTag}
+    {
+    }
+    CommandPacket( Command c, int o, int t ): command{c}, optionalArg{o}, tag{t}
     {
     }
 
     bool operator==( const CommandPacket &rhs ) const 
     {
-      return rhs.command == command && rhs.optionalArg == optionalArg;
+      return rhs.command == command && rhs.optionalArg == optionalArg && rhs.tag == tag;
     }
 
     Command command;
     int optionalArg;
+    /// @brief The host's request tag, echoed back when the command's done.
+    ///        NoTag if there isn't one
+    int tag;
   };
 
   /// @brief Get commands from the network interface
@@ -59,7 +75,8 @@ namespace CommandParser {
   /// @param[in] netInterface - The network interface that we'll query
   ///            for the command.
   /// @return    New requests from netInterface that need to be acted
-  ///            on.
+  ///            on.  BadCommand if a command was read but not 
+  ///            understood, NoCommand only if nothing is waiting.
   ///
   /// TODO 
   /// - Error handling (has none).
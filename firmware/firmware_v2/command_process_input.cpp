@@ -7,6 +7,7 @@
 #include "command_process_input.h"
 #include "command_scheduler.h"
 #include "time_manager.h"
+#include "util_metrics.h"
 
 /////////////////////////////////////////////////////////////////////////
 //
@@ -88,10 +89,17 @@ const std::unordered_map<CommandParser::Command,
   { CommandParser::Command::GetTimeUs,    &ProcessCommand::doGetTimeUs},
   { CommandParser::Command::Profile,      &ProcessCommand::doProfile},
   { CommandParser::Command::RProfile,     &ProcessCommand::doRProfile},
+  { CommandParser::Command::Lateness,     &ProcessCommand::doLateness},
+  { CommandParser::Command::Top,          &ProcessCommand::doTop},
+  { CommandParser::Command::Trace,        &ProcessCommand::doTrace},
+  { CommandParser::Command::Stats,        &ProcessCommand::doStats},
   { CommandParser::Command::DataSend,     &ProcessCommand::doDataSend},
   { CommandParser::Command::RangeSensor,  &ProcessCommand::doRangeSensor},
   { CommandParser::Command::ReadGyro,     &ProcessCommand::doReadGyro},
+  { CommandParser::Command::Protocol,     &ProcessCommand::doProtocol},
+  { CommandParser::Command::UdpTelemetry, &ProcessCommand::doUdpTelemetry},
   { CommandParser::Command::NoCommand,    &ProcessCommand::doError},
+  { CommandParser::Command::BadCommand,   &ProcessCommand::doError},
 };
 
 /////////////////////////////////////////////////////////////////////////
@@ -100,24 +108,60 @@ const std::unordered_map<CommandParser::Command,
 //
 /////////////////////////////////////////////////////////////////////////
 
+//
 // Entry point for all commands
+//
+// A tagged command ends with "@<tag> <received> <dispatched> <replied>",
+// the device times (in us) when its line arrived on the connection, when
+// it started to run, and when it finished.  Every command in a ';' batch
+// shares its line's received time.  Received to dispatched is the wait 
+// for ProcessCommand to get to the line (and the rest of its batch), so
+// the host can tell scheduling delay from link delay.  Output that comes
+// later (i.e., profile dumps) isn't covered.
+//
 void ProcessCommand::processCommand( CommandParser::CommandPacket cp )
 {
+  dispatchedAt = hst->usSinceDeviceStart();
   auto function = commandImpl.at( cp.command );
   (this->*function)( cp );
+
+  if ( cp.tag != CommandParser::NoTag )
+  {
+    NetConnection& connection = net->get();
+    connection << "@" << cp.tag << " " 
+               << receivedAt.get() << " "
+               << dispatchedAt.get() << " "
+               << hst->usSinceDeviceStart().get() << "\n";
+  }
 }
 
+//
+// "ping <hostTime>" replies "PONG <hostTime> <received> <dispatched>
+// <replied>", so the host can take its round trip apart without a tag.
+// hostTime is any number the host likes (i.e., its clock in us, mod 2^31)
+//
 void ProcessCommand::doPing( CommandParser::CommandPacket cp )
 {
-  (void) cp;
-  net->get() << "PONG\n";
+  NetConnection& connection = net->get();
+  if ( cp.optionalArg == CommandParser::NoArg )
+  {
+    connection << "PONG\n";
+    return;
+  }
+  connection << "PONG " << cp.optionalArg << " "
+             << receivedAt.get() << " "
+             << dispatchedAt.get() << " "
+             << hst->usSinceDeviceStart().get() << "\n";
 }
 
+//
+// The parser already counted the line ("Unknown Commands") and echoed it
+//
 void ProcessCommand::doError( CommandParser::CommandPacket cp )
 {
   (void) cp;
   WifiDebugOstream log( debugLog.get(), net->get() );
-  log << "ERROR!!!!\n";
+  log << "Unknown command\n";
 }
 
 void ProcessCommand::doSetMotorL( CommandParser::CommandPacket cp )
@@ -188,10 +232,34 @@ void ProcessCommand::doRProfile( CommandParser::CommandPacket cp )
   scheduler->resetProfile();
 }
 
+void ProcessCommand::doLateness( CommandParser::CommandPacket cp )
+{
+  (void) cp;
+  scheduler->scheduleLateness();
+}
+
+void ProcessCommand::doTop( CommandParser::CommandPacket cp )
+{
+  (void) cp;
+  scheduler->scheduleTop();
+}
+
+void ProcessCommand::doTrace( CommandParser::CommandPacket cp )
+{
+  (void) cp;
+  scheduler->scheduleTrace();
+}
+
+void ProcessCommand::doStats( CommandParser::CommandPacket cp )
+{
+  (void) cp;
+  Util::Metric::reportAll( *net );
+}
+
 void ProcessCommand::doDataSend( CommandParser::CommandPacket cp )
 {
   net->get() << "Datasend " << cp.optionalArg << "\n";
-  dataSend->setOutput( cp.optionalArg != 0 );
+  net->get().setWantsTelemetry( cp.optionalArg != 0 );
 }
 
 void ProcessCommand::doRangeSensor( CommandParser::CommandPacket cp )
@@ -200,6 +268,30 @@ void ProcessCommand::doRangeSensor( CommandParser::CommandPacket cp )
   sr04->sensorRequest();
 }
 
+//
+// The reply goes out in the old protocol, so the host knows exactly where
+// the switch happens.  Anything but 1 means ASCII.
+//
+void ProcessCommand::doProtocol( CommandParser::CommandPacket cp )
+{
+  const NetFrame::Protocol protocol = cp.optionalArg == 1 ? 
+    NetFrame::Protocol::Binary : NetFrame::Protocol::Ascii;
+  net->get() << "protocol " << static_cast<int>( protocol ) << "\n";
+  net->get().setProtocol( protocol );
+}
+
+//
+// Replies with the port telemetry is going to, 0 if it's going down the
+// stream (i.e., because the connection can't do UDP)
+//
+void ProcessCommand::doUdpTelemetry( CommandParser::CommandPacket cp )
+{
+  const bool validPort = cp.optionalArg > 0 && cp.optionalArg <= 0xffff;
+  const uint16_t port = validPort ? cp.optionalArg : 0;
+  const bool opened = net->get().setTelemetryPort( port );
+  net->get() << "udp " << ( opened ? port : 0 ) << "\n";
+}
+
 
 /////////////////////////////////////////////////////////////////////////
 //
@@ -208,18 +300,73 @@ void ProcessCommand::doRangeSensor( CommandParser::CommandPacket cp )
 /////////////////////////////////////////////////////////////////////////
 
 
-Time::TimeUS ProcessCommand::stateAcceptCommands()
+//
+// Each client gets a turn, starting with the one after the last client
+// that was served, so a client that sends a lot can't starve the rest.
+// The client is selected, so responses go back to it.  Anything that
+// reports later on (i.e., scheduler dumps) goes to whoever asked last.
+//
+CommandParser::CommandPacket ProcessCommand::nextCommand()
 {
-  auto cp = CommandParser::checkForCommands( net->get() );
+  const size_t numConnections = net->numConnections();
+  for ( size_t i = 1; i <= numConnections; ++i ) 
+  {
+    const size_t index = ( lastServed + i ) % numConnections;
+    NetConnection& connection = net->connection( index );
+    if ( !connection ) 
+    {
+      continue;
+    }
+    auto cp = CommandParser::checkForCommands( connection );
+    if ( cp.command != CommandParser::Command::NoCommand )
+    {
+      lastServed = index;
+      net->select( index );
+      return cp;
+    }
+  }
+  return CommandParser::CommandPacket();
+}
 
-  if ( cp.command != CommandParser::Command::NoCommand )
+//
+// Handle everything that's waiting, up to the budget, in one slice.
+//
+// 1. Get the next command, from whichever client's turn it is, and look
+//    up when its line arrived
+// 2. Run it, and the rest of its ';' batch.  A batch is never split 
+//    across slices, so i.e., "motorl 50;motorr -50" changes both wheels
+//    before anything else runs.
+// 3. Out of budget - come straight back for the rest
+//
+Time::TimeUS ProcessCommand::stateAcceptCommands()
+{
+  for ( unsigned int handled = 0; handled < commandBudget; ++handled )
   {
+    // 1. Next command
+    auto cp = nextCommand();
+    if ( cp.command == CommandParser::Command::NoCommand )
+    {
+      // The network connection wakes us up when a new line comes in, so 
+      // this is just a backstop.  10 possible updates per second ( 100 ms )
+      return Time::TimeMS( 1000 / 10 );
+    }
+    NetConnection& connection = net->connection( lastServed );
+    receivedAt = connection.lineArrivedAt();
+
+    // 2. Run it, and the rest of its batch
     processCommand( cp );
-    return Time::TimeUS(0);
+    while ( connection.inBatch() ) 
+    {
+      cp = CommandParser::checkForCommands( connection );
+      if ( cp.command != CommandParser::Command::NoCommand )
+      {
+        processCommand( cp );
+      }
+    }
   }
 
-  // 50 possible updates per second ( 20 ms )
-  return Time::TimeMS( 1000 / 50 );
+  // 3. There may be more waiting
+  return Time::TimeUS(0);
 }
 
 Time::TimeUS ProcessCommand::stateError()
@@ -82,6 +82,17 @@ class ProcessCommand: public Base
   ///
   Time::TimeUS execute() override final;
 
+  ///
+  /// @brief Set how many commands are handled per call to execute
+  ///
+  /// Every command waiting (up to the budget) is handled in one slice,
+  /// instead of one per trip through the scheduler.  A ';' batch is 
+  /// always finished, even if that goes over the budget.
+  ///
+  /// @param[in] budget - Commands per slice.  At least 1
+  ///
+  void setCommandBudget( unsigned int budget ) { commandBudget = budget ? budget : 1; }
+
   virtual const char* debugName() override final { return "ProcessInput"; } 
   private:
 
@@ -108,6 +119,8 @@ class ProcessCommand: public Base
 
   /// @brief Wait for commands from the network interface
   Time::TimeUS stateAcceptCommands( void ); 
+  /// @brief Get the next command, taking turns between the clients
+  CommandParser::CommandPacket nextCommand( void );
   /// @brief If we land in this state, complain a lot.
   Time::TimeUS stateError( void );
 
@@ -121,9 +134,15 @@ class ProcessCommand: public Base
   void doGetTimeUs( CommandParser::CommandPacket );
   void doProfile( CommandParser::CommandPacket );
   void doRProfile( CommandParser::CommandPacket );
+  void doLateness( CommandParser::CommandPacket );
+  void doTop( CommandParser::CommandPacket );
+  void doTrace( CommandParser::CommandPacket );
+  void doStats( CommandParser::CommandPacket );
   void doDataSend( CommandParser::CommandPacket );
   void doRangeSensor( CommandParser::CommandPacket );
   void doReadGyro( CommandParser::CommandPacket );
+  void doProtocol( CommandParser::CommandPacket );
+  void doUdpTelemetry( CommandParser::CommandPacket );
   void doError( CommandParser::CommandPacket );
 
   std::shared_ptr<NetInterface> net;
@@ -149,6 +168,16 @@ class ProcessCommand: public Base
   std::shared_ptr<Command::Scheduler > scheduler;
   /// @brief Interface to the data sender, for turning on & off
   std::shared_ptr<Command::DataSend > dataSend;
+  /// @brief The connection that sent the last command
+  size_t lastServed = 0;
+  /// @brief Most commands handled per slice, not counting the rest of a
+  ///        batch
+  unsigned int commandBudget = 8;
+  /// @brief When the line being handled (or its batch) arrived on the
+  ///        connection
+  Time::DeviceTimeUS receivedAt{ 0 };
+  /// @brief When the command being handled started to run
+  Time::DeviceTimeUS dispatchedAt{ 0 };
  
 };
 }; // end namespace Command
@@ -0,0 +1,161 @@
+#ifndef __COMMAND_SCHEDULE_OPTIONS_H__
+#define __COMMAND_SCHEDULE_OPTIONS_H__
+
+#include <optional>
+#include "time_types.h"
+
+namespace Command {
+
+///
+/// @brief What to do when a command falls behind its schedule
+///
+/// A command that asks to run every 10ms but gets started 35ms late has
+/// missed three periods.
+///
+/// Burst - Run the missed periods back to back until the command has
+///         caught up, up to ScheduleOptions::burstLimit of them.  Any 
+///         more are dropped, like Skip.  Good for commands that count on
+///         being called N times (i.e., pulse generators), which can set
+///         the limit to 0.
+/// Skip  - Drop the missed periods and carry on at the next period that's
+///         still in the future, keeping the original phase.  Good for
+///         sampling, where a stale sample isn't worth taking.
+///
+/// The burst limit is what keeps a long stall (i.e., a WiFi reconnect)
+/// from turning into thousands of back to back runs of every command that
+/// didn't ask for Skip.
+///
+enum class CatchUp {
+  Burst,
+  Skip
+};
+
+///
+/// @brief Which commands go first when more than one is overdue
+///
+/// High   - Sampling that needs tight timing (i.e., Encoder, Gyro)
+/// Normal - Everything else
+/// Low    - Bulk work that can wait (i.e., telemetry)
+///
+/// Priority only matters when the scheduler is behind.  If nothing is
+/// overdue commands run at their planned time, same as always.  Within a
+/// priority class the command with the earliest planned start goes first.
+///
+enum class Priority {
+  High,
+  Normal,
+  Low
+};
+
+///
+/// @brief Per command scheduling options, given to the scheduler
+///
+struct ScheduleOptions {
+  CatchUp catchUp = CatchUp::Burst;
+  /// @brief CatchUp::Burst only.  Most missed periods run back to back.
+  ///        0 means there's no limit.
+  unsigned int burstLimit = 2;
+  Priority priority = Priority::Normal;
+  /// @brief Longest execute() should take.  0 means no budget.
+  Time::TimeUS budget = Time::TimeUS( 0 );
+  /// @brief How often the command runs, if it's periodic.  0 if it isn't.
+  ///        Commands with the same period are spread out across it.
+  Time::TimeUS period = Time::TimeUS( 0 );
+  /// @brief Delay the command's first run by this much.  Overrides the
+  ///        spreading done for period.
+  std::optional< Time::TimeUS > phase;
+};
+
+///
+/// @brief Work out how long to delay a command's first run
+///
+/// If a group of commands all run every 10ms and all start at time 0,
+/// they'll all be due in the same slice, forever.  Spreading them out
+/// across the period keeps any one slice from doing all the work.
+///
+/// - A command with a phase gets that phase.
+/// - A command with a period (and no phase) gets an even share of the
+///   period, i.e., the 2nd of 4 10ms commands gets a 2.5ms phase.
+/// - Anything else starts right away.
+///
+/// Shared by Command::Scheduler and Command::StaticScheduler.
+///
+/// @param[in] index       - The command to work out the phase for
+/// @param[in] numCommands - The number of commands
+/// @param[in] optionsAt   - Function that returns the ScheduleOptions for
+///                          a command, given its index
+/// @return The phase
+///
+template< class OptionsAt >
+Time::TimeUS startPhase( size_t index, size_t numCommands, OptionsAt optionsAt )
+{
+  const ScheduleOptions& options = optionsAt( index );
+  if ( options.phase ) {
+    return *options.phase;
+  }
+  if ( options.period.get() == 0 ) {
+    return Time::TimeUS( 0 );
+  }
+
+  size_t position = 0;
+  size_t groupSize = 0;
+  for ( size_t other = 0; other < numCommands; ++other ) {
+    const ScheduleOptions& otherOptions = optionsAt( other );
+    if ( !otherOptions.phase && otherOptions.period == options.period ) {
+      position += other < index ? 1 : 0;
+      ++groupSize;
+    }
+  }
+  return Time::TimeUS( options.period.get() * position / groupSize );
+}
+
+///
+/// @brief Work out when a command should run next
+///
+/// The command asked to be run delayRequest after its planned start time.
+/// If that's already in the past apply the command's catch up policy.  
+/// Either way the periods that are dropped keep the command's phase.
+///
+/// Shared by Command::Scheduler and Command::StaticScheduler so the two
+/// come up with the same schedule.
+///
+/// @param[in] options        - The command's scheduling options
+/// @param[in] plannedStart   - When the command was planned to run
+/// @param[in] delayRequest   - The delay the command's execute() returned
+/// @param[in] now            - The current time
+/// @param[in,out] skippedPeriods - Incremented by the periods that are 
+///                                 dropped
+/// @return When the command should run next
+///
+inline Time::DeviceTimeUS nextStartTime(
+  const ScheduleOptions& options,
+  Time::DeviceTimeUS plannedStart,
+  Time::TimeUS delayRequest,
+  Time::DeviceTimeUS now,
+  unsigned int& skippedPeriods )
+{
+  Time::DeviceTimeUS rescheduleAt = plannedStart + delayRequest;
+
+  const bool isBehind = now > rescheduleAt;
+  if ( !isBehind || delayRequest.get() == 0 ) {
+    return rescheduleAt;
+  }
+
+  // Periods that are due, counting the one at rescheduleAt
+  const unsigned long long periodsMissed = 
+    ( now - rescheduleAt ) / delayRequest.get() + 1;
+  unsigned long long periodsDropped = 0;
+  if ( options.catchUp == CatchUp::Skip ) {
+    periodsDropped = periodsMissed;
+  }
+  else if ( options.burstLimit != 0 && periodsMissed > options.burstLimit ) {
+    periodsDropped = periodsMissed - options.burstLimit;
+  }
+  rescheduleAt = rescheduleAt + periodsDropped * delayRequest.get();
+  skippedPeriods += periodsDropped;
+  return rescheduleAt;
+}
+
+} // end namespace Command
+
+#endif
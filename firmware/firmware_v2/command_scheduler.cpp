@@ -1,3 +1,4 @@
+#include <algorithm>  // for std::make_heap, std::max
 #include "command_scheduler.h"
 
 namespace Command {
@@ -6,76 +7,334 @@ Scheduler::Scheduler(
     std::shared_ptr<NetInterface> netArg,
     std::shared_ptr<HW::I> hardwareArg,
     std::shared_ptr<DebugInterface> debugArg,
-    std::shared_ptr<Time::HST> hstArg ) :
+    std::shared_ptr<Time::HST> hstArg,
+    QueueType queueTypeArg ) :
     net{ netArg },
     hardware{ hardwareArg },
     debug{ debugArg },
     hst{ hstArg },
+    queueType{ queueTypeArg },
     timeInUs{ 0 },
-    profileScheduled{ false }
+    profileScheduled{ false },
+    latenessScheduled{ false },
+    topScheduled{ false },
+    traceScheduled{ false },
+    idleUs{ 0 },
+    topStartTime{ hstArg->usSinceDeviceStart() },
+    tickUs{ 0 },
+    largestTickUs{ 0 },
+    phasesAssigned{ false },
+    anyWakeRequested{ false }
 {
 }
 
-void Scheduler::addCommand( std::shared_ptr< Command::Base > interface )
+Scheduler::ActionRecord::ActionRecord( 
+    std::shared_ptr< Base > commandArg, 
+    const ScheduleOptions& optionsArg ) :
+  command{ commandArg },
+  profile{ commandArg->debugName() },
+  lateness{ commandArg->debugName() },
+  options{ optionsArg }
+{
+}
+
+void Scheduler::addCommand( 
+  std::shared_ptr< Command::Base > interface,
+  const ScheduleOptions& options )
 {
   net->get() << "Command " << interface->debugName() << " added\n";
   size_t slot = actions.size();
-  actions.push_back( ActionRecord{ interface, { interface->debugName() } } );
-  nextCommandQueue.push( PriorityAndCommandSlot( timeInUs, CommandSlotIndex( slot )));
+  actions.push_back( ActionRecord( interface, options ));
+
+  // Start the command now.  Setup can take seconds (i.e., WiFi bring up),
+  // and we don't want every command to start out that far behind.
+  //
+  // Phases get applied on the first execute, when we know every command
+  // that shares a period.  After that only an explicit phase applies.
+  const Time::DeviceTimeUS now = hst->usSinceDeviceStart();
+  Time::DeviceTimeUS startAt = now > timeInUs ? now : timeInUs;
+  if ( phasesAssigned && options.phase ) {
+    startAt = startAt + *options.phase;
+  }
+  queuePush( PriorityAndCommandSlot( startAt, CommandSlotIndex( slot )));
+}
+
+//
+// Move each command with a phase from its start time to start time + phase
+//
+void Scheduler::assignPhases()
+{
+  phasesAssigned = true;
+
+  const Time::DeviceTimeUS now = hst->usSinceDeviceStart();
+  const Time::DeviceTimeUS startAt = now > timeInUs ? now : timeInUs;
+  auto optionsAt = [this]( size_t slot ) -> const ScheduleOptions& { 
+    return actions[ slot ].options; 
+  };
+
+  for ( size_t slot = 0; slot < actions.size(); ++slot ) {
+    const Time::TimeUS phase = startPhase( slot, actions.size(), optionsAt );
+    if ( phase.get() != 0 && queueErase( CommandSlotIndex( slot ))) {
+      queuePush( PriorityAndCommandSlot( startAt + phase, CommandSlotIndex( slot )));
+    }
+  }
+}
+
+void Scheduler::queuePush( const PriorityAndCommandSlot& entry )
+{
+  if ( queueType == QueueType::TimingWheel ) {
+    nextCommandWheel.push( entry );
+  }
+  else {
+    nextCommandQueue.push( entry );
+  }
+}
+
+bool Scheduler::queueEmpty() const
+{
+  if ( queueType == QueueType::TimingWheel ) {
+    return nextCommandWheel.empty();
+  }
+  return nextCommandQueue.empty();
+}
+
+Scheduler::PriorityAndCommandSlot Scheduler::queueTop()
+{
+  if ( queueType == QueueType::TimingWheel ) {
+    return nextCommandWheel.top();
+  }
+  return nextCommandQueue.top();
+}
+
+void Scheduler::queuePop()
+{
+  if ( queueType == QueueType::TimingWheel ) {
+    nextCommandWheel.pop();
+  }
+  else {
+    nextCommandQueue.pop();
+  }
+}
+
+bool Scheduler::CommandHeap::erase( CommandSlotIndex index )
+{
+  for ( auto entry = c.begin(); entry != c.end(); ++entry ) {
+    if ( entry->second == index ) {
+      c.erase( entry );
+      std::make_heap( c.begin(), c.end(), comp );
+      return true;
+    }
+  }
+  return false;
+}
+
+bool Scheduler::queueErase( CommandSlotIndex index )
+{
+  if ( queueType == QueueType::TimingWheel ) {
+    return nextCommandWheel.erase( index );
+  }
+  return nextCommandQueue.erase( index );
+}
+
+//
+// Record the wake and get out.  We might be in an interrupt handler, so
+// the scheduler's queues are off limits.
+//
+// The action's flag is set before anyWakeRequested, and applyWakes clears
+// anyWakeRequested before it looks at the action flags, so a wake can't
+// fall between the cracks.
+//
+// Raw pointers for the search, so the compiler doesn't need to call out
+// to an iterator function from the interrupt.
+//
+OCTO_INTERRUPT_FUNC(void) Scheduler::wake( const Base& command )
+{
+  ActionRecord* action = actions.data();
+  ActionRecord* const end = action + actions.size();
+
+  for ( ; action != end; ++action ) {
+    if ( action->command.get() == &command ) {
+      action->wakeRequested = true;
+      anyWakeRequested = true;
+      return;
+    }
+  }
+}
+
+//
+// Move woken commands from the time queue to the ready queue, as if their
+// planned start time was now.
+//
+void Scheduler::applyWakes( Time::DeviceTimeUS now )
+{
+  if ( !anyWakeRequested ) {
+    return;
+  }
+  anyWakeRequested = false;
+
+  for ( size_t slot = 0; slot < actions.size(); ++slot ) {
+    ActionRecord& action = actions[ slot ];
+    if ( !action.wakeRequested ) {
+      continue;
+    }
+    action.wakeRequested = false;
+
+    // If the command isn't in the time queue it's already due, and
+    // there's nothing to do.
+    if ( queueErase( CommandSlotIndex( slot ))) {
+      readyQueue.push( ReadyCommandSlot( action.options.priority, now, CommandSlotIndex( slot )));
+    }
+  }
+}
+
+//
+// Move every command whose planned start time has come into the ready
+// queue, where priority decides who goes first.
+//
+void Scheduler::moveDueToReady( Time::DeviceTimeUS now )
+{
+  while ( !queueEmpty() && !( queueTop().first > now )) {
+    const PriorityAndCommandSlot due = queueTop();
+    queuePop();
+    const Priority priority = actions.at( due.second.get() ).options.priority;
+    readyQueue.push( ReadyCommandSlot( priority, due.first, due.second ));
+  }
+}
+
+//
+// Overdue commands go first, in priority order.  If nothing is overdue
+// it's the command with the earliest planned start.
+//
+Scheduler::PriorityAndCommandSlot Scheduler::popNextCommand()
+{
+  const Time::DeviceTimeUS now = hst->usSinceDeviceStart();
+  applyWakes( now );
+
+  // Fast path - when the scheduler is keeping up there's at most one
+  // command due, and there's nothing to sort out.
+  if ( readyQueue.empty() ) {
+    const PriorityAndCommandSlot next = queueTop();
+    queuePop();
+    if ( queueEmpty() || queueTop().first > now ) {
+      return next;
+    }
+    const Priority priority = actions.at( next.second.get() ).options.priority;
+    readyQueue.push( ReadyCommandSlot( priority, next.first, next.second ));
+  }
+
+  moveDueToReady( now );
+
+  const ReadyCommandSlot& ready = readyQueue.top();
+  const PriorityAndCommandSlot next( std::get<1>( ready ), std::get<2>( ready ));
+  readyQueue.pop();
+  return next;
 }
 
 //
-// 1. Start the clock
-// 2. Pop the next command to be executed from the priority queue
-// 3. Grather informatin
-// 4. Update the manager time (caller was responsible for the actual delay)
-// 5. Run the Command
+// 1. Pop the next command to be executed.  Overdue commands go in 
+//    priority order, otherwise it's the command with the earliest time.
+// 2. Gather information
+// 3. Update the manager time (caller was responsible for the actual delay)
+// 4. Start the clock & record how late we are
+// 5. Run the Command & record how long it took
 // 6. Figure out the next time the action should be run
 // 7. Add the action back into the queue, at the new time
-// 8. Figure out when the next action will be run & return the value
-// 9. Record profile data
+// 8. Do reports
+// 9. Figure out when the next action will be run & return the delay
 //
 Time::TimeUS Scheduler::execute() 
 {
-  // 1. Start the clock
-  Time::DeviceTimeUS startTime = hst->usSinceDeviceStart();
-
-  // 2. Pop the next command to be executed from the priority queue
-  PriorityAndCommandSlot current = nextCommandQueue.top();
-  nextCommandQueue.pop();
+  // 1. Pop the next command to be executed.  Overdue commands go in 
+  //    priority order, otherwise it's the command with the earliest time.
+  if ( !phasesAssigned ) {
+    assignPhases();
+  }
+  const PriorityAndCommandSlot current = popNextCommand();
 
-  // 3. Gather informatin
+  // 2. Gather information
   const CommandSlotIndex index = current.second;
   ActionRecord& action = actions.at( index.get() );
-  std::shared_ptr<Base>& command = action.first;
-  Util::Profile& profile = action.second;
+  std::shared_ptr<Base>& command = action.command;
 
-  // 4. Update the manager time (caller was responsible for the actual delay)
+  // 3. Update the manager time (caller was responsible for the actual delay)
   timeInUs = current.first;
 
-  // 5. Run the Command
-  Time::TimeUS actionDelayRequestUs = command->execute();
-
-  // 6. Figure out the next time the action should be run
-  Time::DeviceTimeUS rescheduleAt = timeInUs + actionDelayRequestUs;
+  // 4. Start the clock & record how late we are
+  const Time::DeviceTimeUS startTime = hst->usSinceDeviceStart();
+  const Time::TimeUS lateBy( startTime > timeInUs ? startTime - timeInUs : 0 );
+  action.lateness.addSample( lateBy );
 
-  // 7. Add the action back into the queue, at the new time
-  nextCommandQueue.push( PriorityAndCommandSlot( rescheduleAt, index ));
+  // 5. Run the Command & record how long it took
+  const Time::TimeUS actionDelayRequestUs = command->execute();
+  const Time::DeviceTimeUS endTime = hst->usSinceDeviceStart();
+  const Time::TimeUS executeTime( endTime - startTime );
+  action.profile.addSample( executeTime ); 
+  action.recentProfile.addSample( endTime, executeTime );
+  trace.add( Util::TraceEvent{ 
+    startTime.get(),
+    static_cast<int32_t>( startTime.get() - timeInUs.get() ),
+    static_cast<uint32_t>( executeTime.get() ),
+    static_cast<uint16_t>( index.get() ) } );
+  action.busyUs += executeTime.get();
+  tickUs += executeTime.get();
+  ++action.calls;
+  if ( action.options.budget.get() != 0 && executeTime > action.options.budget ) {
+    ++action.overruns;
+  }
 
-  // 8. Figure out when the next action will be run & return the value
-  Time::TimeUS delay_to_next_action(nextCommandQueue.top().first - timeInUs );
+  // 6. Figure out the next time the action should be run
+  const Time::DeviceTimeUS rescheduleAt = nextStartTime( 
+    action.options, timeInUs, actionDelayRequestUs, endTime, 
+    action.skippedPeriods );
 
-  // 9. Record profile data
-  Time::DeviceTimeUS endTime = hst->usSinceDeviceStart();
-  profile.addSample( Time::TimeUS(endTime - startTime )); 
+  // 7. Add the action back into the queue, at the new time.  If it's
+  //    already due it goes straight to the ready queue, which also keeps
+  //    the timing wheel from having to move backwards.
+  if ( !( rescheduleAt > endTime )) {
+    readyQueue.push( ReadyCommandSlot( action.options.priority, rescheduleAt, index ));
+  }
+  else {
+    queuePush( PriorityAndCommandSlot( rescheduleAt, index ));
+  }
 
-  // Do profile dumps on the !tracked portion, so they don't pollute results
+  // 8. Do reports on the !tracked portion, so they don't pollute results
   if ( profileScheduled ) {
     dumpProfile();
     profileScheduled=false;
   }
-  
-  return delay_to_next_action;
+  if ( latenessScheduled ) {
+    dumpLateness();
+    latenessScheduled=false;
+  }
+  if ( topScheduled ) {
+    dumpTop();
+    topScheduled=false;
+  }
+  if ( traceScheduled ) {
+    dumpTrace();
+    traceScheduled=false;
+  }
+
+  // 9. Figure out when the next action will be run & return the delay.
+  //
+  // The delay is measured against the clock, not timeInUs, so time spent
+  // running commands comes out of the delay instead of pushing the whole
+  // schedule back.  If we're behind, don't wait at all.
+  //
+  // A tick is the run of commands done back to back, with no delay.
+  //
+  if ( !readyQueue.empty() ) {
+    return Time::TimeUS( 0 );
+  }
+  const Time::DeviceTimeUS nextAt = queueTop().first;
+  const Time::DeviceTimeUS now = hst->usSinceDeviceStart();
+  const Time::TimeUS delay( nextAt > now ? nextAt - now : 0 );
+  if ( delay.get() != 0 ) {
+    largestTickUs = std::max( largestTickUs, tickUs );
+    tickUs = 0;
+  }
+  idleUs += delay.get();
+  return delay;
 }
 
 void Scheduler::scheduleProfile()
@@ -83,12 +342,140 @@ void Scheduler::scheduleProfile()
   profileScheduled=true;
 }
 
+void Scheduler::scheduleLateness()
+{
+  latenessScheduled=true;
+}
+
+void Scheduler::scheduleTop()
+{
+  topScheduled=true;
+}
+
+void Scheduler::scheduleTrace()
+{
+  traceScheduled=true;
+}
+
+//
+// Since boot on the first line, the last 10 seconds underneath, so a 
+// recent change stands out.
+//
 void Scheduler::dumpProfile() const
 {
+  const Time::DeviceTimeUS now = hst->usSinceDeviceStart();
+  for ( const auto& action: actions ) 
+  {
+    action.profile.reportOneLiner( *net );
+    action.recentProfile.reportOneLiner( *net, now, "  last 10s" );
+  }
+  for ( const Util::Probe* probe = Util::Probe::first(); probe != nullptr; probe = probe->next() )
+  {
+    probe->getProfile().reportOneLiner( *net );
+  }
+}
+
+void Scheduler::dumpLateness() const
+{
+  for ( const auto& action: actions ) 
+  {
+    action.lateness.reportOneLiner( *net );
+    if ( action.options.catchUp == CatchUp::Skip || action.skippedPeriods != 0 ) 
+    {
+      net->get() << "  skipped " << action.skippedPeriods << " periods\n";
+    }
+  }
+}
+
+namespace {
+
+// Print part / whole as a percentage with one decimal place, i.e., 12.3%
+void printPercent( NetConnection& connection, unsigned long long part, unsigned long long whole )
+{
+  const unsigned long long tenths = whole ? ( part * 1000 + whole / 2 ) / whole : 0;
+  connection << tenths / 10 << "." << static_cast<unsigned int>( tenths % 10 ) << "%";
+}
+
+} // end anonymous namespace
+
+//
+// Like the Unix top command.  Where the time went since the last reset:
+//
+// 1. Overall - time in commands, time returned to loop() as delays, and
+//    whatever's left over (the scheduler itself, and loop() overhead).
+//    Also the most work done in a single tick.
+// 2. Per command - share of the time, calls, average execute() time, and
+//    execution budget overruns
+//
+void Scheduler::dumpTop() const
+{
+  auto& connection = net->get();
+  const unsigned long long elapsed = hst->usSinceDeviceStart() - topStartTime;
+
+  // 1. Overall
+  unsigned long long busyUs = 0;
   for ( const auto& action: actions ) 
   {
-    const Util::Profile& profile = action.second;
-    profile.reportOneLiner( *net );
+    busyUs += action.busyUs;
+  }
+  const unsigned long long accounted = busyUs + idleUs;
+  const unsigned long long overheadUs = elapsed > accounted ? elapsed - accounted : 0;
+
+  connection << "elapsed = " << elapsed / 1000 << "ms   busy = ";
+  printPercent( connection, busyUs, elapsed );
+  connection << "   idle = ";
+  printPercent( connection, idleUs, elapsed );
+  connection << "   overhead = ";
+  printPercent( connection, overheadUs, elapsed );
+  connection << "   largest tick = " << largestTickUs << "uS\n";
+
+  // 2. Per command
+  for ( const auto& action: actions ) 
+  {
+    const std::string name = action.command->debugName();
+    connection << name;
+    for ( size_t i = name.length(); i < 20; ++i ) 
+    {
+      connection << " ";
+    }
+    connection << " cpu = ";
+    printPercent( connection, action.busyUs, elapsed );
+    connection << "   calls = " << action.calls;
+    connection << "   avg = " << ( action.calls ? action.busyUs / action.calls : 0 ) << "uS";
+    if ( action.options.budget.get() != 0 ) 
+    {
+      connection << "   budget = " << action.options.budget.get() << "uS";
+      connection << "   overruns = " << action.overruns;
+      if ( action.overruns != 0 ) 
+      {
+        connection << " OVER BUDGET";
+      }
+    }
+    connection << "\n";
+  }
+}
+
+//
+// Dump the trace, oldest event first.  The command names go first so the
+// events can just use the index.
+//
+//   TRN <index> <name>
+//   TRC <index> <planned start> <actual start> <end>
+//
+void Scheduler::dumpTrace() const
+{
+  auto& connection = net->get();
+  for ( size_t index = 0; index < actions.size(); ++index ) 
+  {
+    connection << "TRN " << static_cast<unsigned int>( index ) << " " << commandName( index ) << "\n";
+  }
+  for ( size_t i = 0; i < trace.size(); ++i ) 
+  {
+    const Util::TraceEvent& event = trace.at( i );
+    connection << "TRC " << static_cast<unsigned int>( event.index ) 
+               << " " << event.planned()
+               << " " << event.start
+               << " " << event.end() << "\n";
   }
 }
 
@@ -96,12 +483,22 @@ void Scheduler::resetProfile()
 {
   for ( auto& action: actions ) 
   {
-    Util::Profile& profile = action.second;
-    profile.reset();
+    action.profile.reset();
+    action.recentProfile.reset();
+    action.lateness.reset();
+    action.skippedPeriods = 0;
+    action.busyUs = 0;
+    action.calls = 0;
+    action.overruns = 0;
   }
+  trace.reset();
+  Util::Probe::resetAll();
+  idleUs = 0;
+  tickUs = 0;
+  largestTickUs = 0;
+  topStartTime = hst->usSinceDeviceStart();
 }
 
 
 } // end Command namespace
 
-
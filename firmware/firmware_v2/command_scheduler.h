@@ -4,13 +4,19 @@
 #include <memory>     // for std::shared_ptr
 #include <vector>     // for std::vector
 #include <queue>      // for std::priority_queue
+#include <tuple>      // for std::tuple
 
+#include "basic_types.h"
 #include "command_base.h"
+#include "command_schedule_options.h"
 #include "debug_interface.h"
 #include "hardware_interface.h"
 #include "net_interface.h"
 #include "time_interface.h"
 #include "util_profile.h"
+#include "util_windowed_profile.h"
+#include "util_timing_wheel.h"
+#include "util_trace.h"
 #include "time_hst.h"
 
 namespace Command {
@@ -20,21 +26,110 @@ namespace Command {
 class Scheduler: Base {
   public:
 
-  using ActionRecord = std::pair< std::shared_ptr< Base >, Util::Profile >;
+  ///
+  /// @brief Everything the scheduler tracks for a single command
+  ///
+  /// Most of it is the three histograms.  The budget is 1.5K a command, 
+  /// about 20K for the robot's 13 commands.
+  ///
+  struct ActionRecord {
+    ActionRecord( std::shared_ptr< Base > commandArg, const ScheduleOptions& optionsArg );
+
+    /// @brief The command
+    std::shared_ptr< Base > command;
+    /// @brief How long command->execute() takes
+    Util::Profile profile;
+    /// @brief How long command->execute() took over the last 10 seconds
+    Util::WindowedProfile recentProfile;
+    /// @brief How late command->execute() started vs. when it was planned
+    Util::Profile lateness;
+    /// @brief Options the command was added with
+    ScheduleOptions options;
+    /// @brief Number of periods dropped to catch up
+    unsigned int skippedPeriods = 0;
+    /// @brief Total time spent in command->execute()
+    unsigned long long busyUs = 0;
+    /// @brief Number of times command->execute() was called
+    unsigned int calls = 0;
+    /// @brief Number of times command->execute() took longer than budget
+    unsigned int overruns = 0;
+    /// @brief Set by wake(), cleared when the scheduler acts on it
+    volatile bool wakeRequested = false;
+  };
+  static_assert( sizeof( ActionRecord ) <= 1536, "over the per command RAM budget" );
+
+  ///
+  /// @brief The data structure that keeps commands in "next to run" order
+  ///
+  /// Heap        - std::priority_queue.  O(log n) push and pop
+  /// TimingWheel - Util::TimingWheel.  O(1) push and pop
+  ///
+  /// Both run commands in the same order.
+  ///
+  enum class QueueType {
+    Heap,
+    TimingWheel
+  };
 
   Scheduler(
     std::shared_ptr<NetInterface> netArg,
     std::shared_ptr<HW::I> hardwareArg,
     std::shared_ptr<DebugInterface> debugArg,
-    std::shared_ptr<Time::HST> hstArg );
+    std::shared_ptr<Time::HST> hstArg,
+    QueueType queueTypeArg = QueueType::Heap );
 
-  void addCommand( std::shared_ptr< Base > interface );
+  void addCommand( 
+    std::shared_ptr< Base > interface,
+    const ScheduleOptions& options = ScheduleOptions() );
   virtual Time::TimeUS execute() override final;
   virtual const char* debugName() override { return "CommandScheduler"; }
 
+  ///
+  /// @brief Run a command at the next slice, without waiting out its delay
+  ///
+  /// Safe to call from an interrupt handler.  The wake is only recorded
+  /// here - the next execute() moves the command to the front of the line
+  /// and runs it in priority order with anything else that's due.  The
+  /// command's next delay is measured from when it ran.
+  ///
+  /// Commands that are already due, and commands that were never added,
+  /// are left alone.
+  ///
+  /// Looks the command up with a linear search, which is fine for the
+  /// dozen or so commands the robot has.
+  ///
+  /// @param[in] command - The command to wake
+  ///
+  OCTO_INTERRUPT_FUNC(void) wake( const Base& command );
+
   void dumpProfile() const;
+  void dumpLateness() const;
+  void dumpTop() const;
+  void dumpTrace() const;
   void resetProfile();
   void scheduleProfile();
+  void scheduleLateness();
+  void scheduleTop();
+  void scheduleTrace();
+
+  /// @brief Number of slices the trace holds
+  static constexpr size_t traceSize = 128;
+  using Trace = Util::TraceBuffer< traceSize >;
+
+  /// @brief The last traceSize command runs
+  const Trace& getTrace() const { return trace; }
+
+  /// @brief Number of commands added
+  size_t numCommands() const { return actions.size(); }
+
+  /// @brief Debug name of a command, by index (i.e., TraceEvent::index)
+  const char* commandName( size_t index ) const 
+  { 
+    return actions.at( index ).command->debugName(); 
+  }
+
+  /// @brief Longest run of commands executed back to back, without a delay
+  Time::TimeUS largestTick() const { return Time::TimeUS( largestTickUs ); }
 
   private:
 
@@ -43,6 +138,17 @@ class Scheduler: Base {
 
 
   using PriorityAndCommandSlot = std::pair<Time::DeviceTimeUS, CommandSlotIndex >;
+  using ReadyCommandSlot = std::tuple<Priority, Time::DeviceTimeUS, CommandSlotIndex >;
+
+  void queuePush( const PriorityAndCommandSlot& entry );
+  bool queueEmpty() const;
+  PriorityAndCommandSlot queueTop();
+  void queuePop();
+  bool queueErase( CommandSlotIndex index );
+  void moveDueToReady( Time::DeviceTimeUS now );
+  void applyWakes( Time::DeviceTimeUS now );
+  void assignPhases();
+  PriorityAndCommandSlot popNextCommand();
 
   std::shared_ptr<NetInterface> net;
   std::shared_ptr<HW::I> hardware;
@@ -51,18 +157,60 @@ class Scheduler: Base {
 
   std::vector< ActionRecord > actions;
 
+  //
+  // std::priority_queue, plus the ability to take out a command that
+  // isn't at the top (for wake).  That's O(n), but wakes are rare next
+  // to pushes & pops.
+  //
+  class CommandHeap: public std::priority_queue<
+    PriorityAndCommandSlot,
+    std::vector<PriorityAndCommandSlot>,
+    std::greater<PriorityAndCommandSlot> >
+  {
+    public:
+
+    bool erase( CommandSlotIndex index );
+  };
+
   //
   // keep the actions in "next action to run" order.  probably safe from
   // memory fragmentation - the std::priority_queue is a container wrapper
   // that probably just maintains a heap on the vector.  The max size of
   // the vector won't change during runtime.
   //
-  std::priority_queue< 
-    PriorityAndCommandSlot, 
-    std::vector<PriorityAndCommandSlot>, 
-    std::greater<PriorityAndCommandSlot> > nextCommandQueue;
+  CommandHeap nextCommandQueue;
+  //
+  // Same job as nextCommandQueue, used if queueType is TimingWheel.
+  //
+  Util::TimingWheel< CommandSlotIndex > nextCommandWheel;
+  //
+  // Commands that are due, in priority & then planned start time order.
+  // Commands only sit here when the scheduler is behind.
+  //
+  std::priority_queue<
+    ReadyCommandSlot,
+    std::vector<ReadyCommandSlot>,
+    std::greater<ReadyCommandSlot> > readyQueue;
+  const QueueType queueType;
   Time::DeviceTimeUS timeInUs;
   bool profileScheduled;
+  bool latenessScheduled;
+  bool topScheduled;
+  bool traceScheduled;
+  // The last traceSize command runs, for dumpTrace
+  Trace trace;
+  // Total of the delays execute() returned, for dumpTop
+  unsigned long long idleUs;
+  // When the dumpTop numbers started accumulating
+  Time::DeviceTimeUS topStartTime;
+  // Time spent in commands since execute() last returned a delay
+  unsigned long long tickUs;
+  // Largest tickUs seen
+  unsigned long long largestTickUs;
+  // Have the start phases been applied?  Done on the first execute()
+  bool phasesAssigned;
+  // Set by wake() if any action has wakeRequested set
+  volatile bool anyWakeRequested;
 };
 
 } // end namespace Command
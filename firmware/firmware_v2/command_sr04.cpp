@@ -6,6 +6,8 @@
 namespace Command{
 
 const Time::DeviceTimeUS echoTimeout{ 4500 };
+// @brief Time between pulses, and between polls while idle.  50x a second
+const Time::TimeUS pulsePeriod{ 20000 };
 
 SR04::SR04( 
   std::shared_ptr<HW::I> hwiArg, 
@@ -19,6 +21,9 @@ SR04::SR04(
   hst{ hstArg },
   pinTrig{ pinTrigArg }, pinEcho{ pinEchoArg },
   mode{ Mode::IDLE },
+  currentSample{ -1 },
+  pulseOut{ false },
+  nextPulseAt{ 0 },
   lastSensorReading{ -1 }
 {
   // Configure hardware pins for output
@@ -128,36 +133,62 @@ void SR04::sendPulse()
   hwi->DigitalWrite( pinTrig, HW::PinState::ECHO_OFF );
 }
 
+//
+// Output the median and reset the state.
+//
+// The median sample was used because the range finder I tested seems
+// to occasionally produce a very inaccurate result.  i.e.,  I'd get
+// readings like 1005, 998, 500 when the object was about 10cm away.
+//
+void SR04::finishReading()
+{
+  std::sort( samples.begin(), samples.end() );
+  //net->get() << "RNG " << samples[numSamples/2] << "\n";
+  lastSensorReading = samples[numSamples/2];
+  currentSample = -1;
+  mode = Mode::IDLE;
+}
+
+//
+// Runs every pulsePeriod, and early if the echo interrupt wakes us up.
+//
+// 1. A pulse is out.  Process its result.  If that was the last sample
+//    the reading is done.
+// 2. Not time for the next pulse yet (i.e., we were woken early) - sleep
+//    until it is
+// 3. Send the next pulse
+//
 Time::TimeUS SR04::execute() 
 {
-  if ( mode == Mode::DOING_READING ) {
-    if ( currentSample != -1 ) {
-      // If we're not doing the first reading there should be a pulse result
-      SR04::processPulseResult();
-    }
-    if ( currentSample < numSamples-1 ) {
-      // If we're not doing the last reading then we need to send a pulse
-      SR04::sendPulse();
+  if ( mode != Mode::DOING_READING ) {
+    return pulsePeriod;
+  }
+
+  // 1. Process the result
+  if ( pulseOut ) {
+    pulseOut = false;
+    processPulseResult();
+    if ( mode != Mode::DOING_READING ) {
+      return pulsePeriod;
     }
-    ++currentSample;
-    if ( currentSample == numSamples ) {
-      //
-      // Output the medium and reset the state.
-      //
-      // The medium sample was used because the range finder I tested seems
-      // to occasionally produce a very inaccurate result.  i.e.,  I'd get
-      // readings like 1005, 998, 500 when the object was about 10cm away.
-      //
-      std::sort( samples.begin(), samples.end() );
-      //net->get() << "RNG " << samples[numSamples/2] << "\n";
-      lastSensorReading = samples[numSamples/2];
-      currentSample = -1;
-      mode = Mode::IDLE;
+    if ( currentSample == numSamples - 1 ) {
+      finishReading();
+      return pulsePeriod;
     }
   }
 
-  // Update at 50x a second
-  return Time::TimeUS{ 20000 };
+  // 2. Wait for the next pulse
+  const Time::DeviceTimeUS now = hst->usSinceDeviceStart();
+  if ( nextPulseAt > now ) {
+    return Time::TimeUS( nextPulseAt - now );
+  }
+
+  // 3. Send it.  pulseOut goes first, so the echo can't beat it
+  ++currentSample;
+  nextPulseAt = now + pulsePeriod;
+  pulseOut = true;
+  SR04::sendPulse();
+  return pulsePeriod;
 }
 
 //
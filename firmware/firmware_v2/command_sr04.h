@@ -36,6 +36,10 @@ namespace Command {
 /// to respond.  If we actually get called every 20ms the accuracy of the 
 /// sensor will be about +.68 cm.  That might do.
 ///
+/// Pulses go out every 20ms no matter what, so one pulse's stray echoes
+/// have died down before the next goes out.  A wake when the echo ends 
+/// (see waitingForEcho) only gets the result processed sooner.
+///
 /// If we do want more accuracy, another idea would be to do a course sensor
 /// reading to get a general of the distance, and then do a fine sensor
 /// reading that's a bit more blocking.  
@@ -86,10 +90,19 @@ class SR04: public Base {
   /// 
   int getLastSensorReading();
 
+  ///
+  /// @brief Is a pulse out, with the result not processed yet?
+  ///
+  /// Safe to call from the echo interrupt.  Only a wake while this is 
+  /// true does any good.
+  ///
+  bool waitingForEcho() const { return pulseOut; }
+
   private:
 
   void processPulseResult();
   void sendPulse();
+  void finishReading();
 
   enum class Mode {
     IDLE,
@@ -116,9 +129,17 @@ class SR04: public Base {
   // @brief How many samples should we take during a reading
   static constexpr int numSamples = 3;
 
-  // @brief What sample are we receiving right now?
+  // @brief What sample are we receiving right now?  -1 before the first
+  //        pulse of a reading goes out
   int currentSample;
 
+  // @brief Has the current sample's pulse gone out without its result 
+  //        being processed?
+  volatile bool pulseOut;
+
+  // @brief When the next pulse can go out
+  Time::DeviceTimeUS nextPulseAt;
+
   // @brief The samples done to date
   std::array<unsigned int, numSamples > samples;
 
@@ -0,0 +1,255 @@
+#ifndef __COMMAND_STATIC_SCHEDULER_H__
+#define __COMMAND_STATIC_SCHEDULER_H__
+
+#include <algorithm>  // for std::push_heap, std::pop_heap
+#include <array>      // for std::array
+#include <assert.h>
+#include <functional> // for std::greater
+#include <memory>     // for std::shared_ptr
+#include <tuple>      // for std::tuple
+#include <utility>    // for std::pair
+
+#include "command_schedule_options.h"
+#include "time_hst.h"
+
+namespace Command {
+
+///
+/// @brief A scheduler for a command set that's fixed at compile time
+///
+/// The robot's command set never changes after setup(), so we don't need
+/// Command::Scheduler's std::shared_ptr< Base > and virtual execute() for
+/// every slice.  This scheduler takes the concrete command types as a
+/// parameter pack.
+///
+/// - Dispatch is a chain of compares on the command index that ends in a
+///   qualified (non-virtual) call to the command's execute().  The
+///   compiler can inline the whole thing.
+/// - All storage is std::array sized by the number of commands, so there
+///   are no heap allocations.
+/// - The ordering rules are the same as Command::Scheduler's - earliest
+///   planned start first, ties to the lowest index, overdue commands in
+///   priority order, the catch up policy from nextStartTime(), and start
+///   phases from startPhase().  Given the same commands and options the
+///   two produce the same schedule.
+///
+/// What it leaves out, to stay small: profiling, lateness tracking, and
+/// wake().
+///
+/// Use Example:
+///
+///   Command::StaticScheduler< Command::Motor, Command::Encoder > scheduler(
+///     hst, *motor, *encoder );
+///   scheduler.setOptions( 1, sampling );
+///   for ( ;; ) { sleep( scheduler.execute() ); }
+///
+/// @param[in] Commands - The command types, in the order they should be
+///                       indexed.  Each needs an execute() that returns
+///                       Time::TimeUS.
+///
+template< class... Commands >
+class StaticScheduler
+{
+  public:
+
+  static constexpr size_t numCommands = sizeof...( Commands );
+  static_assert( numCommands > 0, "a scheduler needs at least one command" );
+
+  ///
+  /// @brief Constructor.  Every command is scheduled to start now.
+  ///
+  /// @param[in] hstArg      - The high speed timer
+  /// @param[in] commandsArg - The commands.  The scheduler keeps references,
+  ///                          so the commands have to outlive it.
+  ///
+  StaticScheduler( std::shared_ptr<Time::HST> hstArg, Commands&... commandsArg ) :
+    hst{ hstArg },
+    commands{ commandsArg... },
+    timeInUs{ hstArg->usSinceDeviceStart() }
+  {
+    for ( size_t index = 0; index < numCommands; ++index ) {
+      queuePush( PlannedCommand( timeInUs, index ));
+    }
+  }
+
+  ///
+  /// @brief Set a command's scheduling options.  Call before execute()
+  ///
+  /// @param[in] index   - The command's position in Commands
+  /// @param[in] options - The options
+  ///
+  void setOptions( size_t index, const ScheduleOptions& options )
+  {
+    assert( index < numCommands );
+    optionsByIndex[ index ] = options;
+  }
+
+  ///
+  /// @brief Run the next command
+  ///
+  /// Same steps as Command::Scheduler::execute, minus the profiling.
+  ///
+  /// @return How long the caller should wait before calling execute again
+  ///
+  Time::TimeUS execute()
+  {
+    // 0. Apply start phases, now that all the options are set
+    if ( !phasesAssigned ) {
+      assignPhases();
+    }
+
+    // 1. Pop the next command to be executed.  Overdue commands go in
+    //    priority order, otherwise it's the command with the earliest time.
+    const PlannedCommand current = popNextCommand();
+    const size_t index = current.second;
+
+    // 2. Update the scheduler time
+    timeInUs = current.first;
+
+    // 3. Run the Command
+    const Time::TimeUS delayRequest = dispatch( index );
+    const Time::DeviceTimeUS endTime = hst->usSinceDeviceStart();
+
+    // 4. Figure out the next time the command should be run & requeue it
+    const Time::DeviceTimeUS rescheduleAt = nextStartTime(
+      optionsByIndex[ index ], timeInUs, delayRequest, endTime,
+      skippedPeriods[ index ] );
+
+    if ( !( rescheduleAt > endTime )) {
+      readyPush( ReadyCommand( optionsByIndex[ index ].priority, rescheduleAt, index ));
+    }
+    else {
+      queuePush( PlannedCommand( rescheduleAt, index ));
+    }
+
+    // 5. Figure out when the next command will be run & return the delay.
+    if ( readySize != 0 ) {
+      return Time::TimeUS( 0 );
+    }
+    const Time::DeviceTimeUS nextAt = queue[ 0 ].first;
+    const Time::DeviceTimeUS now = hst->usSinceDeviceStart();
+    return Time::TimeUS( nextAt > now ? nextAt - now : 0 );
+  }
+
+  /// @brief Number of periods dropped to catch up, for a command
+  unsigned int getSkippedPeriods( size_t index ) const
+  {
+    return skippedPeriods[ index ];
+  }
+
+  private:
+
+  using PlannedCommand = std::pair< Time::DeviceTimeUS, size_t >;
+  using ReadyCommand = std::tuple< Priority, Time::DeviceTimeUS, size_t >;
+
+  //
+  // Call execute() on command number "index".  The call is qualified with
+  // the command's type, so it isn't virtual even if execute() is.
+  //
+  template< size_t I = 0 >
+  Time::TimeUS dispatch( size_t index )
+  {
+    if constexpr ( I < numCommands ) {
+      if ( index == I ) {
+        using CommandType = std::tuple_element_t< I, std::tuple< Commands... > >;
+        return std::get< I >( commands ).CommandType::execute();
+      }
+      return dispatch< I + 1 >( index );
+    }
+    else {
+      assert( 0 );
+      return Time::TimeUS( 0 );
+    }
+  }
+
+  //
+  // Same logic as Command::Scheduler::assignPhases.  Nothing has run yet,
+  // so the queue can just be rebuilt.
+  //
+  void assignPhases()
+  {
+    phasesAssigned = true;
+
+    const Time::DeviceTimeUS now = hst->usSinceDeviceStart();
+    const Time::DeviceTimeUS startAt = now > timeInUs ? now : timeInUs;
+    auto optionsAt = [this]( size_t index ) -> const ScheduleOptions& {
+      return optionsByIndex[ index ];
+    };
+
+    queueSize = 0;
+    for ( size_t index = 0; index < numCommands; ++index ) {
+      const Time::TimeUS phase = startPhase( index, numCommands, optionsAt );
+      queuePush( PlannedCommand( phase.get() != 0 ? startAt + phase : timeInUs, index ));
+    }
+  }
+
+  //
+  // Same logic as Command::Scheduler::popNextCommand
+  //
+  PlannedCommand popNextCommand()
+  {
+    const Time::DeviceTimeUS now = hst->usSinceDeviceStart();
+
+    if ( readySize == 0 ) {
+      const PlannedCommand next = queuePop();
+      if ( queueSize == 0 || queue[ 0 ].first > now ) {
+        return next;
+      }
+      readyPush( ReadyCommand( optionsByIndex[ next.second ].priority, next.first, next.second ));
+    }
+
+    while ( queueSize != 0 && !( queue[ 0 ].first > now )) {
+      const PlannedCommand due = queuePop();
+      readyPush( ReadyCommand( optionsByIndex[ due.second ].priority, due.first, due.second ));
+    }
+
+    std::pop_heap( ready.begin(), ready.begin() + readySize, std::greater< ReadyCommand >() );
+    --readySize;
+    return PlannedCommand( std::get<1>( ready[ readySize ] ), std::get<2>( ready[ readySize ] ));
+  }
+
+  void queuePush( const PlannedCommand& entry )
+  {
+    assert( queueSize < numCommands );
+    queue[ queueSize++ ] = entry;
+    std::push_heap( queue.begin(), queue.begin() + queueSize, std::greater< PlannedCommand >() );
+  }
+
+  PlannedCommand queuePop()
+  {
+    std::pop_heap( queue.begin(), queue.begin() + queueSize, std::greater< PlannedCommand >() );
+    return queue[ --queueSize ];
+  }
+
+  void readyPush( const ReadyCommand& entry )
+  {
+    assert( readySize < numCommands );
+    ready[ readySize++ ] = entry;
+    std::push_heap( ready.begin(), ready.begin() + readySize, std::greater< ReadyCommand >() );
+  }
+
+  // @brief Interface to the high speed timer
+  std::shared_ptr<Time::HST> hst;
+  // @brief The commands
+  std::tuple< Commands&... > commands;
+  // @brief Options for each command, by index
+  std::array< ScheduleOptions, numCommands > optionsByIndex;
+  // @brief Periods dropped to catch up, by index
+  std::array< unsigned int, numCommands > skippedPeriods{};
+
+  // @brief Commands waiting for their start time, as a heap
+  std::array< PlannedCommand, numCommands > queue;
+  size_t queueSize = 0;
+  // @brief Commands that are overdue, as a heap in priority order
+  std::array< ReadyCommand, numCommands > ready;
+  size_t readySize = 0;
+
+  // @brief Planned start time of the command being run
+  Time::DeviceTimeUS timeInUs;
+  // @brief Have the start phases been applied?
+  bool phasesAssigned = false;
+};
+
+} // end namespace Command
+
+#endif
@@ -3,6 +3,8 @@
 namespace HW {
 
 const std::unordered_map<Pin,std::string,EnumHash> pinNames = {
+    { Pin::I2C_SDA,         "I2C SDA" },
+    { Pin::I2C_SCL,         "I2C SCL" },
     { Pin::SR04_TRIG,       "SR04 Trigger" },
     { Pin::SR04_ECHO,       "SR04 Echo" },
     { Pin::LED_PIN,         "WS2812 Out" },
@@ -23,7 +23,7 @@ namespace HW {
 
 enum class Pin {
   START_OF_PINS = 0,
-  I2C_SDA,
+  I2C_SDA = 0,
   I2C_SCL,
   SR04_TRIG,
   SR04_ECHO,
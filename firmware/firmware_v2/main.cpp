@@ -10,10 +10,25 @@
 #include "time_esp8266.h"
 #include "time_esp8266hst.h"
 #include "time_manager.h"
+#include "util_probe.h"
 #include "wifi_secrets.h"
 
 std::shared_ptr<Command::Scheduler> scheduler;
 
+//
+// SR04 echo interrupt listener.  Wake the SR04 up as soon as the echo
+// pulse ends, so it doesn't have to poll for the result.  Only while it's
+// waiting for one - edges at any other time (i.e., stray echoes while 
+// idle) are left for the regular poll.
+//
+OCTO_INTERRUPT_FUNC(void) wakeOnEchoEnd( void* sr04Arg, const Util::IPinEvent& event )
+{
+  const Command::SR04& sr04 = *static_cast<Command::SR04*>( sr04Arg );
+  if ( event.first == HW::PinState::INPUT_LOW && sr04.waitingForEcho() ) {
+    scheduler->wake( sr04 );
+  }
+}
+
 void loop() {
   Time::TimeUS pause = scheduler->execute();
   if ( pause != Time::TimeUS(0) )
@@ -30,8 +45,11 @@ void setup() {
   auto wifi      = std::make_shared<WifiInterfaceEthernet>(debug);
   auto hst       = std::make_shared<Time::ESP8266_HST>();
   auto hardware  = std::make_shared<HW::HardwareESP8266>( hst );
+  Util::Probe::setClock( hst );
+  NetConnection::setArrivalClock( hst );
   scheduler      = std::make_shared<Command::Scheduler>( 
-                        wifi, hardware, debug, hst );
+                        wifi, hardware, debug, hst,
+                        Command::Scheduler::QueueType::TimingWheel );
   auto timeNNTP  = std::make_shared<TimeESP8266>( debug );
   auto time      = std::make_shared<Time::Manager>( timeNNTP, hst );
   auto motorA = std::make_shared<Command::Motor>( hardware, debug, 0);
@@ -44,7 +62,7 @@ void setup() {
   auto gyro     = std::make_shared<Command::Gyro> ( hardware, debug );
           
   auto dataSend = std::make_shared<Command::DataSend>( debug, wifi, 
-                        encoderA, encoderB, sr04, gyro, hardware );
+                        encoderA, encoderB, sr04, gyro, hardware, hst );
 
   auto commandProcessor= std::make_shared<Command::ProcessCommand>( 
                         wifi, hardware, debug, 
@@ -57,16 +75,45 @@ void setup() {
                         scheduler,
                         dataSend );
 
+  // Sensors - a late sample is worth less than a sample on time, and
+  // sampling goes ahead of everything else when the scheduler is behind.
+  // The encoders and gyro run every 10ms.
+  Command::ScheduleOptions sampling;
+  sampling.catchUp = Command::CatchUp::Skip;
+  sampling.priority = Command::Priority::High;
+  sampling.budget = Time::TimeUS( 1000 );
+  sampling.period = Time::TimeUS( 10000 );
+
+  // Telemetry - can wait for the sensors.  Also every 10ms, so it gets
+  // spread out with the sensors.
+  Command::ScheduleOptions telemetry;
+  telemetry.catchUp = Command::CatchUp::Skip;
+  telemetry.priority = Command::Priority::Low;
+  telemetry.budget = Time::TimeUS( 2000 );
+  telemetry.period = Time::TimeUS( 10000 );
+
+  Command::ScheduleOptions background;
+  background.priority = Command::Priority::Low;
+
   scheduler->addCommand( commandProcessor);
   scheduler->addCommand( motorA );
   scheduler->addCommand( motorB );
-  scheduler->addCommand( encoderA );
-  scheduler->addCommand( encoderB );
+  scheduler->addCommand( encoderA, sampling );
+  scheduler->addCommand( encoderB, sampling );
   scheduler->addCommand( sr04 );
-  scheduler->addCommand( wifi );
-  auto connection = wifi->getShared();
-  scheduler->addCommand( connection );
+  scheduler->addCommand( wifi, background );
+  for ( size_t i = 0; i < wifi->numConnections(); ++i ) {
+    scheduler->addCommand( wifi->connectionShared( i ));
+  }
   scheduler->addCommand( hst );
-  scheduler->addCommand( dataSend );
-  scheduler->addCommand( gyro );
+  scheduler->addCommand( dataSend, telemetry );
+  scheduler->addCommand( gyro, sampling );
+
+  // Event driven wakeups
+  for ( size_t i = 0; i < wifi->numConnections(); ++i ) {
+    wifi->connection( i ).setNewLineListener( 
+      [commandProcessor]() { scheduler->wake( *commandProcessor ); } );
+  }
+  hardware->GetInputEvents( HW::Pin::SR04_ECHO ).setListener( 
+    wakeOnEchoEnd, sr04.get() );
 }
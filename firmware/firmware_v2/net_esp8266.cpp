@@ -1,8 +1,22 @@
+#include <algorithm>
+#include <cstring>
 #include <memory>
 #include "net_interface.h"
 #include "net_esp8266.h"
 #include "wifi_ostream.h"
 #include "wifi_debug_ostream.h"
+#include "util_metrics.h"
+
+namespace {
+const char* const noFreeSlots = "# No free slots - Dropping Your Connection.\n";
+Util::Metric bytesSent( "Net Bytes Sent" );
+Util::Metric bytesReceived( "Net Bytes Received" );
+Util::Metric writeCalls( "Net Write Calls" );
+// Every slot shares the gauges, so only slots with a client set them.  They
+// show the last client polled
+Util::Metric writeWindow( "Net Write Window", Util::Metric::Kind::Gauge );
+Util::Metric pollInterval( "Net Poll Interval", Util::Metric::Kind::Gauge );
+} // end anonymous namespace
 
 #ifdef FOO
 WifiInterfaceEthernet::WifiInterfaceEthernet(
@@ -10,7 +24,10 @@ WifiInterfaceEthernet::WifiInterfaceEthernet(
 ) 
   : log{ logArg }
 {
-  defaultConnection = std::make_shared< WifiConnectionEthernet>( logArg );
+  for ( auto& connection: connections ) 
+  {
+    connection = std::make_shared< WifiConnectionEthernet>( logArg );
+  }
   delay(10);
   (*log) << "Init Wifi\n";
 
@@ -58,7 +75,10 @@ WifiInterfaceEthernet::WifiInterfaceEthernet(
 ) 
   : log{ logArg }
 {
-  defaultConnection = std::make_shared< WifiConnectionEthernet>( logArg );
+  for ( auto& connection: connections ) 
+  {
+    connection = std::make_shared< WifiConnectionEthernet>( logArg );
+  }
   delay(10);
   (*log) << "Init Wifi\n";
 
@@ -86,71 +106,173 @@ WifiInterfaceEthernet::WifiInterfaceEthernet(
 }
 
 
+//
+// New clients get the first free slot.  If every slot is taken the new
+// client is told so and hung up on - the clients already connected keep
+// going.
+//
 Time::TimeUS WifiInterfaceEthernet::execute()
 {
   if ( m_server.hasClient() )
   {  
     (*log) << "New client connecting\n";
-   
-    defaultConnection->initConnection( m_server );
+
+    auto freeSlot = std::find_if( connections.begin(), connections.end(), 
+      []( const std::shared_ptr<WifiConnectionEthernet>& connection ) { 
+        return !*connection; 
+      });
+    if ( freeSlot != connections.end() ) 
+    {
+      (*freeSlot)->initConnection( m_server );
+    }
+    else 
+    {
+      WiFiClient client = m_server.available();
+      client.write( noFreeSlots, strlen( noFreeSlots ));
+      client.stop();
+    }
   }
   return Time::TimeUS{ 10 * 1000 };
 }
 
 void WifiInterfaceEthernet::reset(void)
 {
-  defaultConnection->reset();
+  for ( auto& connection: connections ) 
+  {
+    connection->reset();
+  }
 }
 
 // ==========================================================================
 
 void WifiConnectionEthernet::initConnection( WiFiServer &server )
 {
-  if ( m_connectedClient )
-  {
-      (*this) << "# New Client and no free slots - Dropping Your Connection.\n";
-      m_connectedClient.stop();
-  }
   m_connectedClient = server.available();
+  // Every new client starts out in ASCII with no telemetry, and asks for
+  // telemetry, binary or UDP if it wants them.  Nothing from the slot's
+  // last client carries over.
+  setProtocol( NetFrame::Protocol::Ascii );
+  setTelemetryPort( 0 );
+  setWantsTelemetry( false );
+  poll = NetPoll();
+  readBuffer.readAdvance( readBuffer.available() );
+  writeBuffer.readAdvance( writeBuffer.available() );
   m_connectedClient.setNoDelay( true );
   m_connectedClient.setSync( false );
   (*this) << "# Urban Octo Robot is ready for commands\n"; 
 }
 
+//
+// The write pipe is full of command responses.  Telemetry has its own
+// pipe, so nothing here is safe to throw away - block until the client
+// takes some of it.  If the client has gone away (or the write times out)
+// nothing is taken, and NetConnection::flush hangs up.
+//
 void WifiConnectionEthernet::writePushImpl( NetPipe& pipe )
 {
-  pipe.getChar();
+  size_t written = 0;
+  if ( m_connectedClient ) 
+  {
+    for ( const NetPipe::Buffer& outBuf: pipe.readViews( pipe.available() ))
+    {
+      if ( outBuf.second == 0 ) { break; }
+      const size_t accepted = m_connectedClient.write( outBuf.first, outBuf.second );
+      written += accepted;
+      if ( accepted != outBuf.second ) { break; }
+    }
+  }
+  pipe.readAdvance( written );
+  bytesSent.increment( written );
 }
 
-Time::TimeUS WifiConnectionEthernet::execute()
+bool WifiConnectionEthernet::openDatagramImpl( uint16_t port )
 {
-  static int flipper = 0;
+  m_udpPort = port;
+  return port == 0 || m_connectedClient;
+}
 
-  flipper++;
+//
+// One datagram per sample.  lwIP copies the packet out in endPacket, so
+// this doesn't wait for the radio.
+//
+bool WifiConnectionEthernet::sendDatagramImpl( const uint8_t* data, size_t length )
+{
+  if ( m_udpPort == 0 || !m_connectedClient ) 
+  {
+    return false;
+  }
+  if ( !m_udp.beginPacket( m_connectedClient.remoteIP(), m_udpPort )) 
+  {
+    return false;
+  }
+  const size_t written = m_udp.write( data, length );
+  return m_udp.endPacket() && written == length;
+}
+
+//
+// Both directions every poll, and the poll rate follows the traffic - see
+// NetPoll.
+//
+// 1. Read whatever the client sent
+// 2. Top up the write pipe with telemetry, up to what the client can take
+// 3. Send, unless it's a few bytes worth holding for company
+// 4. Pick the next poll
+//
+Time::TimeUS WifiConnectionEthernet::execute()
+{
+  const bool hasClient = m_connectedClient;
+  size_t moved = 0;
 
-  if ( (flipper & 1) == 0 ) {
-  size_t maxWrite = m_connectedClient.availableForWrite();
-  if ( maxWrite ) 
+  // 1. Read
+  int numAvailable = m_connectedClient.available();
+  if ( numAvailable > 0 ) 
   {
-    NetPipe::Buffer outBuf = writeBuffer.readView( maxWrite );
-    if ( outBuf.second ) 
+    for ( const NetReadPipe::Buffer& inBuff: readBuffer.writeViews( numAvailable ))
     {
-      size_t written = m_connectedClient.write( outBuf.first, outBuf.second );
-      writeBuffer.readAdvance( written );
+      if ( inBuff.second == 0 ) { break; }
+      int numRead = m_connectedClient.read( (uint8_t*) inBuff.first, inBuff.second );
+      if ( numRead <= 0 ) { break; }
+      readBuffer.writeAdvance( numRead );
+      bytesReceived.increment( numRead );
+      moved += numRead;
+      dataReceived( inBuff.first, numRead );
+      if ( static_cast<size_t>( numRead ) != inBuff.second ) { break; }
     }
   }
-  }
-  else {
-  int numAvailable = m_connectedClient.available();
-  if ( numAvailable ) 
+
+  // 2. Telemetry.  pumpTelemetry leaves room for the responses already
+  //    waiting, so it gets the whole window
+  const size_t maxWrite = m_connectedClient.availableForWrite();
+  if ( hasClient ) 
   {
-    NetPipe::Buffer inBuff = readBuffer.writeView( numAvailable );
-    int numRead = m_connectedClient.read( (uint8_t*) inBuff.first, inBuff.second );
-    readBuffer.writeAdvance( numRead );
+    writeWindow.set( maxWrite );
   }
+  pumpTelemetry( maxWrite );
+
+  // 3. Send.  Both halves if the data wraps, so the part at the start of 
+  //    the pipe doesn't wait for the next poll.  Stop if the client takes
+  //    less than we offered.
+  if ( maxWrite && poll.readyToSend( writeBuffer.available() )) 
+  {
+    size_t written = 0;
+    for ( const NetPipe::Buffer& outBuf: writeBuffer.readViews( maxWrite ))
+    {
+      if ( outBuf.second == 0 ) { break; }
+      const size_t accepted = m_connectedClient.write( outBuf.first, outBuf.second );
+      written += accepted;
+      if ( accepted != outBuf.second ) { break; }
+    }
+    writeBuffer.readAdvance( written );
+    bytesSent.increment( written );
+    writeCalls.increment();
+    moved += written;
   }
 
-  return Time::TimeUS( 1000 );
+  // 4. Next poll
+  const Time::TimeUS next = poll.next( moved != 0, writeBuffer.available() != 0 );
+  if ( hasClient ) 
+  {
+    pollInterval.set( next.get() );
+  }
+  return next;
 }
-
-
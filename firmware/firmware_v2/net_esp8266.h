@@ -1,13 +1,16 @@
 #ifndef __WifiInterfaceEthernet_H__
 #define __WifiInterfaceEthernet_H__
 
+#include <array>
 #include <string>
 #include <memory>
 #include <ios>
 #include <ESP8266WiFi.h>
+#include <WiFiUdp.h>
 #include "wifi_ostream.h"
 #include "wifi_secrets.h"
 #include "debug_interface.h"
+#include "net_poll.h"
 
 class WifiOstream;
 
@@ -40,6 +43,8 @@ class WifiConnectionEthernet: public NetConnection {
   }
 
   void writePushImpl( NetPipe& pipe );
+  bool openDatagramImpl( uint16_t port ) override;
+  bool sendDatagramImpl( const uint8_t* data, size_t length ) override;
 
   Time::TimeUS execute();
 
@@ -51,6 +56,12 @@ class WifiConnectionEthernet: public NetConnection {
   private:
 
   WiFiClient m_connectedClient;
+  // @brief Telemetry datagrams, to the client's address
+  WiFiUDP m_udp;
+  // @brief The client's telemetry port.  0 if there isn't one
+  uint16_t m_udpPort = 0;
+  // @brief Poll rate and small write coalescing
+  NetPoll poll;
   std::shared_ptr<DebugInterface> debug;
 };
 
@@ -77,14 +88,22 @@ class WifiInterfaceEthernet: public NetInterface {
   //std::unique_ptr<NetConnection> connect( const std::string& location, unsigned int port );
   NetConnection& get() override
   {
-    assert( defaultConnection );
-    return *defaultConnection;
+    assert( connections[ current ] );
+    return *connections[ current ];
   }
 
   std::shared_ptr<NetConnection> getShared() {
-    return defaultConnection;
+    return connections[ current ];
   }
 
+  size_t numConnections() override { return maxClients; }
+  NetConnection& connection( size_t index ) override { return *connections[ index ]; }
+  std::shared_ptr<NetConnection> connectionShared( size_t index ) override 
+  { 
+    return connections[ index ]; 
+  }
+  void select( size_t index ) override { current = index; }
+
   Time::TimeUS execute();
   
   private:
@@ -96,9 +115,15 @@ class WifiInterfaceEthernet: public NetInterface {
   static constexpr const char* password = WifiSecrets::password;
   static constexpr const char* hostname = WifiSecrets::hostname;
   const uint16_t tcp_port{4999};
+  // @brief How many clients can be connected at once.  Each one costs
+  //        about 3K of pipes, plus lwIP's buffers
+  static constexpr size_t maxClients = 3;
 
   std::shared_ptr<DebugInterface> log;
-  std::shared_ptr<WifiConnectionEthernet> defaultConnection;
+  // @brief One connection per client slot.  A slot that tests false is free
+  std::array< std::shared_ptr<WifiConnectionEthernet>, maxClients > connections;
+  // @brief The slot get() returns - whoever sent the current command
+  size_t current = 0;
 
   WiFiServer m_server{tcp_port};
 };
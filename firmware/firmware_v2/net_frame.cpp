@@ -0,0 +1,164 @@
+#include <algorithm>
+#include <cstring>
+#include "net_frame.h"
+
+namespace NetFrame {
+
+namespace {
+
+int16_t clamp16( int value )
+{
+  return static_cast<int16_t>( std::min( std::max( value, -32768 ), 32767 ));
+}
+
+} // end anonymous namespace
+
+//
+// The sums are only reduced mod 255 at the end.  The ESP8266 has no
+// divider, and 32 bits is plenty for a maxFrame sized block.
+//
+uint16_t checksum( const uint8_t* data, size_t length, uint16_t seed )
+{
+  static_assert( maxFrame < 4096, "sums could overflow" );
+  uint32_t sum1 = seed & 0xff;
+  uint32_t sum2 = seed >> 8;
+  for ( size_t i = 0; i < length; ++i ) {
+    sum1 += data[ i ];
+    sum2 += sum1;
+  }
+  return static_cast<uint16_t>((( sum2 % 255 ) << 8 ) | ( sum1 % 255 ));
+}
+
+//
+// 1. Header
+// 2. Payload
+// 3. Checksum over everything but the sync byte
+//
+size_t encode( Type type, const uint8_t* payload, size_t length, uint8_t* out )
+{
+  // 1. Header
+  out[ 0 ] = sync;
+  out[ 1 ] = static_cast<uint8_t>( type );
+  out[ 2 ] = static_cast<uint8_t>( length );
+
+  // 2. Payload
+  memcpy( out + headerSize, payload, length );
+
+  // 3. Checksum
+  const uint16_t check = checksum( out + 1, length + headerSize - 1 );
+  putLE16( out + headerSize + length, check );
+  return length + overhead;
+}
+
+TelemetryRecord TelemetryRecord::fromSample( 
+  int encoderLPosition, int encoderLSpeed, 
+  int encoderRPosition, int encoderRSpeed, 
+  int range, int gyroAngle )
+{
+  TelemetryRecord record;
+  record.encoderLPosition = encoderLPosition;
+  record.encoderLSpeed    = clamp16( encoderLSpeed );
+  record.encoderRPosition = encoderRPosition;
+  record.encoderRSpeed    = clamp16( encoderRSpeed );
+  record.range            = clamp16( range );
+  record.gyroAngle        = clamp16( gyroAngle );
+  return record;
+}
+
+void TelemetryRecord::encodeFrame( uint8_t* out ) const
+{
+  uint8_t payload[ size ];
+  encodePayload( payload );
+  encode( Type::Telemetry, payload, size, out );
+}
+
+uint8_t* TelemetryRecord::encodePayload( uint8_t* p ) const
+{
+  p = putLE32( p, static_cast<uint32_t>( encoderLPosition ));
+  p = putLE16( p, static_cast<uint16_t>( encoderLSpeed ));
+  p = putLE32( p, static_cast<uint32_t>( encoderRPosition ));
+  p = putLE16( p, static_cast<uint16_t>( encoderRSpeed ));
+  p = putLE16( p, static_cast<uint16_t>( range ));
+  return putLE16( p, static_cast<uint16_t>( gyroAngle ));
+}
+
+TelemetryRecord TelemetryRecord::decode( const uint8_t* payload )
+{
+  TelemetryRecord record;
+  record.encoderLPosition = static_cast<int32_t>( getLE32( payload + 0 ));
+  record.encoderLSpeed    = static_cast<int16_t>( getLE16( payload + 4 ));
+  record.encoderRPosition = static_cast<int32_t>( getLE32( payload + 6 ));
+  record.encoderRSpeed    = static_cast<int16_t>( getLE16( payload + 10 ));
+  record.range            = static_cast<int16_t>( getLE16( payload + 12 ));
+  record.gyroAngle        = static_cast<int16_t>( getLE16( payload + 14 ));
+  return record;
+}
+
+void TelemetryDatagram::encodeFrame( uint8_t* out ) const
+{
+  uint8_t payload[ size ];
+  uint8_t* p = payload;
+  p = putLE32( p, sequence );
+  p = putLE32( p, deviceTimeUs );
+  record.encodePayload( p );
+  encode( Type::TelemetryDatagram, payload, size, out );
+}
+
+TelemetryDatagram TelemetryDatagram::decode( const uint8_t* payload )
+{
+  TelemetryDatagram datagram;
+  datagram.sequence     = getLE32( payload );
+  datagram.deviceTimeUs = getLE32( payload + 4 );
+  datagram.record       = TelemetryRecord::decode( payload + 8 );
+  return datagram;
+}
+
+bool Decoder::push( uint8_t byte )
+{
+  switch ( state ) {
+    case State::Sync:
+      if ( byte == sync ) {
+        state = State::Type;
+      }
+      return false;
+    case State::Type:
+      frameType = byte;
+      check = checksum( &byte, 1 );
+      state = State::Length;
+      return false;
+    case State::Length:
+      payloadLength = byte;
+      received = 0;
+      check = checksum( &byte, 1, check );
+      state = payloadLength == 0 ? State::CheckLow : State::Payload;
+      return false;
+    case State::Payload:
+      data[ received++ ] = byte;
+      if ( received == payloadLength ) {
+        check = checksum( data.data(), payloadLength, check );
+        state = State::CheckLow;
+      }
+      return false;
+    case State::CheckLow:
+      if ( byte != ( check & 0xff )) {
+        ++numBadFrames;
+        state = byte == sync ? State::Type : State::Sync;
+        return false;
+      }
+      state = State::CheckHigh;
+      return false;
+    case State::CheckHigh:
+      state = State::Sync;
+      if ( byte != ( check >> 8 )) {
+        ++numBadFrames;
+        if ( byte == sync ) {
+          state = State::Type;
+        }
+        return false;
+      }
+      return true;
+  }
+  return false;
+}
+
+} // end namespace NetFrame
@@ -0,0 +1,201 @@
+#ifndef __NET_FRAME_H__
+#define __NET_FRAME_H__
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+///
+/// @brief Binary framing for the host link
+///
+/// The link starts out as ASCII lines.  A host that wants binary sends
+/// "protocol 1", gets "protocol 1" back as the last ASCII line, and from
+/// then on both directions are frames:
+///
+///   byte 0       sync (0xA5)
+///   byte 1       type
+///   byte 2       payload length, 0 - 255
+///   bytes 3..    payload
+///   last 2 bytes Fletcher-16 of the type, length and payload, little endian
+///
+/// Every multi-byte field is little endian.  Hosts that never ask for
+/// binary keep getting ASCII.
+///
+namespace NetFrame {
+
+/// @brief Which protocol a connection is speaking
+enum class Protocol {
+  Ascii = 0,      ///< Newline terminated text (the default)
+  Binary = 1      ///< Frames
+};
+
+/// @brief What's in a frame
+enum class Type : uint8_t {
+  Text      = 1,  ///< A line of text, without the newline.  Responses
+  Command   = 2,  ///< Host to device.  Opcode, then an optional int32 arg
+  Telemetry = 3,  ///< A TelemetryRecord
+  TelemetryDatagram = 4, ///< A TelemetryDatagram, sent over UDP
+};
+
+constexpr uint8_t sync = 0xA5;
+constexpr size_t headerSize = 3;
+constexpr size_t trailerSize = 2;
+constexpr size_t overhead = headerSize + trailerSize;
+constexpr size_t maxPayload = 255;
+constexpr size_t maxFrame = maxPayload + overhead;
+
+/// @brief Enough bytes for the largest frame
+using Buffer = std::array< uint8_t, maxFrame >;
+
+/// @brief Fletcher-16 checksum
+uint16_t checksum( const uint8_t* data, size_t length, uint16_t seed = 0 );
+
+///
+/// @brief Build a frame
+///
+/// @param[in]  type    - What's in the payload
+/// @param[in]  payload - The payload
+/// @param[in]  length  - Payload length.  At most maxPayload
+/// @param[out] out     - Where to build the frame.  Needs length + overhead
+///                       bytes
+/// @return The frame length
+///
+size_t encode( Type type, const uint8_t* payload, size_t length, uint8_t* out );
+
+///
+/// @brief The DataSend sample, as a fixed 16 byte payload
+///
+/// Replaces the ENL, ENR, RNG and GYR lines.  Values that don't fit in 16
+/// bits are clamped.
+///
+struct TelemetryRecord {
+  int32_t encoderLPosition;
+  int16_t encoderLSpeed;
+  int32_t encoderRPosition;
+  int16_t encoderRSpeed;
+  int16_t range;
+  int16_t gyroAngle;
+
+  static constexpr size_t size = 16;
+  static constexpr size_t frameSize = size + overhead;
+
+  /// @brief Build a record from DataSend's readings, clamping as needed
+  static TelemetryRecord fromSample( 
+    int encoderLPosition, int encoderLSpeed, 
+    int encoderRPosition, int encoderRSpeed, 
+    int range, int gyroAngle );
+
+  /// @brief Write the record as a whole Telemetry frame
+  ///
+  /// @param[out] out - Where to build the frame.  Needs frameSize bytes
+  ///
+  void encodeFrame( uint8_t* out ) const;
+
+  /// @brief Write just the payload
+  ///
+  /// @param[out] out - Where to write it.  Needs size bytes
+  /// @return The byte after the payload
+  ///
+  uint8_t* encodePayload( uint8_t* out ) const;
+
+  /// @brief Read the record back from a Telemetry payload
+  static TelemetryRecord decode( const uint8_t* payload );
+};
+
+///
+/// @brief One UDP telemetry packet
+///
+/// A whole TelemetryDatagram frame per packet, so each packet stands on
+/// its own.  The sequence number goes up by one per packet, so the host
+/// can count lost and reordered packets, and the device time lets it
+/// measure latency and jitter.
+///
+struct TelemetryDatagram {
+  uint32_t sequence;
+  /// @brief Low 32 bits of Time::DeviceTimeUS when the sample was taken
+  uint32_t deviceTimeUs;
+  TelemetryRecord record;
+
+  static constexpr size_t size = 8 + TelemetryRecord::size;
+  static constexpr size_t frameSize = size + overhead;
+
+  /// @brief Write the datagram as a whole TelemetryDatagram frame
+  ///
+  /// @param[out] out - Where to build the frame.  Needs frameSize bytes
+  ///
+  void encodeFrame( uint8_t* out ) const;
+
+  /// @brief Read the datagram back from a TelemetryDatagram payload
+  static TelemetryDatagram decode( const uint8_t* payload );
+};
+
+///
+/// @brief Pulls frames out of a byte stream
+///
+/// Feed it bytes one at a time.  Anything that isn't a frame with a good
+/// checksum is skipped, and the decoder looks for the next sync byte.
+///
+class Decoder {
+  public:
+
+  ///
+  /// @brief Add a byte
+  ///
+  /// @return true if the byte completed a good frame.  type() and
+  ///         payload() are valid until the next call to push
+  ///
+  bool push( uint8_t byte );
+
+  Type type() const { return static_cast<Type>( frameType ); }
+  const uint8_t* payload() const { return data.data(); }
+  size_t length() const { return payloadLength; }
+
+  /// @brief Frames thrown away because the checksum was wrong
+  unsigned int badFrames() const { return numBadFrames; }
+
+  /// @brief Forget any partly decoded frame
+  void reset() { state = State::Sync; }
+
+  private:
+
+  enum class State { Sync, Type, Length, Payload, CheckLow, CheckHigh };
+
+  State state = State::Sync;
+  uint8_t frameType = 0;
+  size_t payloadLength = 0;
+  size_t received = 0;
+  uint16_t check = 0;
+  unsigned int numBadFrames = 0;
+  std::array< uint8_t, maxPayload > data;
+};
+
+/// @brief Write a little endian 16 bit value
+inline uint8_t* putLE16( uint8_t* out, uint16_t value )
+{
+  out[ 0 ] = value & 0xff;
+  out[ 1 ] = value >> 8;
+  return out + 2;
+}
+
+/// @brief Write a little endian 32 bit value
+inline uint8_t* putLE32( uint8_t* out, uint32_t value )
+{
+  out = putLE16( out, value & 0xffff );
+  return putLE16( out, value >> 16 );
+}
+
+/// @brief Read a little endian 16 bit value
+inline uint16_t getLE16( const uint8_t* in )
+{
+  return static_cast<uint16_t>( in[ 0 ] | ( in[ 1 ] << 8 ));
+}
+
+/// @brief Read a little endian 32 bit value
+inline uint32_t getLE32( const uint8_t* in )
+{
+  return getLE16( in ) | ( static_cast<uint32_t>( getLE16( in + 2 )) << 16 );
+}
+
+} // end namespace NetFrame
+
+#endif
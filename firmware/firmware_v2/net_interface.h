@@ -3,17 +3,120 @@
 
 #include <string>
 #include <string>
+#include <cstring>
+#include <functional>
 #include <memory>
 #include <assert.h>
 #include "command_base.h"
 #include "hardware_interface.h"
 #include "debug_interface.h"
+#include "net_frame.h"
+#include "time_hst.h"
+#include "util_metrics.h"
 #include "util_pipe.h"
+#include "util_probe.h"
 
 class WifiOstream;
 class WifiDebugOstream;
 
-using NetPipe = Util::Pipe<char, 1024>;
+class NetConnection;
+
+/// @brief Output pipe.  When it's full the connection has to flush it
+using NetPipe = Util::Pipe<char, 1024, Util::PipeOverflow::BlockFlush<NetConnection>>;
+/// @brief Input pipe.  When it's full the oldest input is lost
+using NetReadPipe = Util::Pipe<char, 1024, Util::PipeOverflow::DropOldest>;
+/// @brief Telemetry pipe.  When it's full the oldest whole line is lost
+using NetTelemetryPipe = Util::Pipe<char, 512, Util::PipeOverflow::DropOldestLine>;
+
+///
+/// @brief Sink for periodic telemetry (i.e., DataSend's ENL/ENR lines)
+///
+/// Telemetry is only worth anything while it's fresh, so unlike command
+/// responses it's never worth blocking for.  It's held in its own pipe
+/// and, if the link can't keep up, the oldest lines are thrown away whole
+/// so the host never has to resync on a half line.
+///
+/// On a binary connection the pipe holds whole frames instead, written
+/// with writeFrame, and the oldest frames are thrown away whole.
+///
+class NetTelemetry {
+  public:
+
+  struct category : public beefocus_tag {};
+  using char_type = char;
+
+  NetTelemetry( NetTelemetryPipe& pipeArg, Util::Metric* dropsArg ) : 
+    pipe{ pipeArg }, drops{ dropsArg }
+  {
+  }
+
+  ///
+  /// @brief Transfer data from s into the telemetry pipe
+  ///
+  /// Never blocks.  If the pipe fills, putChar drops old lines to make
+  /// room.
+  ///
+  std::streamsize write( const char_type* s, std::streamsize n )
+  {
+    size_t remaining = n;
+    while ( remaining != 0 )
+    {
+      const size_t written = pipe.write( s, remaining );
+      s += written;
+      remaining -= written;
+      if ( remaining != 0 )
+      {
+        pipe.putChar( *s );
+        ++s;
+        --remaining;
+      }
+    }
+    return n;
+  }
+
+  ///
+  /// @brief Add a whole frame to the telemetry pipe
+  ///
+  /// Drops the oldest frames until the new one fits.
+  ///
+  void writeFrame( const uint8_t* frame, size_t length )
+  {
+    while ( pipe.space() < length && pipe.available() != 0 )
+    {
+      drops->increment();
+      // Only whole frames go in, so there's always a whole frame to drop.
+      // If there isn't the pipe's corrupt - start over.
+      const size_t oldest = frameLength( pipe );
+      pipe.readAdvance( oldest != 0 ? oldest : pipe.available() );
+    }
+    pipe.write( reinterpret_cast<const char_type*>( frame ), length );
+  }
+
+  ///
+  /// @brief Length of the frame at the start of a pipe
+  ///
+  /// @return The frame length, or 0 if the whole frame isn't there yet
+  ///
+  static size_t frameLength( NetTelemetryPipe& pipe )
+  {
+    uint8_t header[ NetFrame::headerSize ];
+    if ( pipe.available() < NetFrame::headerSize ) { return 0; }
+    size_t copied = 0;
+    for ( const NetTelemetryPipe::Buffer& part: pipe.readViews( NetFrame::headerSize ))
+    {
+      if ( part.second == 0 ) { break; }
+      memcpy( header + copied, part.first, part.second );
+      copied += part.second;
+    }
+    const size_t length = header[ 2 ] + NetFrame::overhead;
+    return pipe.available() < length ? 0 : length;
+  }
+
+  private:
+
+  NetTelemetryPipe& pipe;
+  Util::Metric* drops;
+};
 
 class NetConnection: public Command::Base {
   public:
@@ -23,8 +126,10 @@ class NetConnection: public Command::Base {
 
   /// Constructor 
   NetConnection() :
-    writeBuffer{ [this]( NetPipe& pipe) { writePush(pipe);} },
-    readBuffer { [this]( NetPipe& pipe) { readPush(pipe);} }
+    writeBuffer{ Util::PipeOverflow::BlockFlush<NetConnection>{ this } },
+    readBuffer { Util::PipeOverflow::DropOldest{ &readOverflows } },
+    telemetryBuffer{ Util::PipeOverflow::DropOldestLine{ &telemetryDrops } },
+    telemetryStream{ telemetryBuffer, &telemetryDrops }
   {
   }
 
@@ -33,33 +138,205 @@ class NetConnection: public Command::Base {
   {
   }
 
-  /// Called when we've filled the output pipe.  Forces a blocking write
-  /// (i.e., clear the pipe, whatever it takes)
-  void writePush(NetPipe& pipe)
+  /// Called when we've filled the output pipe.  Forces a blocking write.
+  ///
+  /// The pipe only holds command responses, so nothing in it can be
+  /// dropped on its own - the host would get half a line.  If the client 
+  /// takes none of it (it's gone, or it stopped reading) the connection is
+  /// hung up instead, and whatever was waiting goes with it.
+  void flush(NetPipe& pipe)
   {
+    writePushes.increment();
+    const size_t waiting = pipe.available();
     writePushImpl( pipe );
+    if ( pipe.available() == waiting ) 
+    {
+      stalledHangups.increment();
+      responseDrops.increment( waiting );
+      pipe.readAdvance( waiting );
+      reset();
+    }
+  }
+
+
+  ///
+  /// @brief Transfer data from s into the write pipe.
+  ///
+  /// Pushes (same as putChar on a full pipe) until everything fits.  On a
+  /// binary connection each line goes out as a Text frame instead.
+  ///
+  std::streamsize write( const char_type* s, std::streamsize n )
+  {
+    OCTO_PROBE_SCOPE( "Net Write" );
+    if ( currentProtocol == NetFrame::Protocol::Binary ) 
+    {
+      writeText( s, n );
+      return n;
+    }
+    writeBytes( s, n );
+    return n;
+  }
+
+  ///
+  /// @brief Transfer data from s into the write pipe as is.
+  ///
+  /// Pushes (same as putChar on a full pipe) until everything fits.  If
+  /// a push hangs up on the client the rest is thrown away, so the next
+  /// client doesn't start with the tail of a line.
+  ///
+  void writeBytes( const char_type* s, size_t n )
+  {
+    size_t remaining = n;
+    for ( ;; ) 
+    {
+      const size_t written = writeBuffer.write( s, remaining );
+      s += written;
+      remaining -= written;
+      if ( remaining == 0 ) 
+      {
+        break;
+      }
+      flush( writeBuffer );
+      if ( !*this ) 
+      {
+        break;
+      }
+    }
   }
 
-  /// Called when we've filled the input pipe.  Should never trigger unless
-  /// there's a bug or malice.
-  void readPush(NetPipe &)
+  /// @brief Which protocol the connection is speaking
+  NetFrame::Protocol protocol() const { return currentProtocol; }
+
+  ///
+  /// @brief Switch protocols
+  ///
+  /// Output that's already been written goes out in the old protocol.
+  /// Telemetry that hasn't been sent yet is thrown away, since the host
+  /// couldn't parse it anymore, along with any partly received input and
+  /// the rest of a ';' batch.
+  ///
+  void setProtocol( NetFrame::Protocol newProtocol )
   {
-    assert(0);
+    flushText();
+    telemetryBuffer.readAdvance( telemetryBuffer.available() );
+    frameDecoder.reset();
+    clearCommandLine();
+    currentProtocol = newProtocol;
   }
 
+  /// @brief Where periodic telemetry goes.  Command responses go to the
+  ///        connection itself.
+  NetTelemetry& telemetry() { return telemetryStream; }
 
   ///
-  /// @brief Legacy interface that transfers data from s into the write pipe.
+  /// @brief Send telemetry as UDP datagrams instead of down the stream
   ///
-  /// TODO,  remove and call the pipe directly for speed.
+  /// The datagrams go to the client's address.  A lost datagram is just
+  /// lost, so old telemetry never holds up command responses the way a
+  /// TCP retransmit does.
   ///
-  std::streamsize write( const char_type* s, std::streamsize n )
+  /// @param[in] port - The client's UDP port.  0 goes back to sending
+  ///                   telemetry down the stream
+  /// @return false if the connection can't do UDP
+  ///
+  bool setTelemetryPort( uint16_t port )
+  {
+    const bool opened = openDatagramImpl( port );
+    telemetryPort = opened ? port : 0;
+    return opened;
+  }
+
+  /// @brief Is telemetry going out as UDP datagrams?
+  bool sendsTelemetryDatagrams() const { return telemetryPort != 0; }
+
+  /// @brief Does this client want telemetry?  Each client turns it on for
+  ///        itself with "datasend 1"
+  bool wantsTelemetry() const { return telemetryOn; }
+  void setWantsTelemetry( bool on ) { telemetryOn = on; }
+
+  ///
+  /// @brief The command line being collected from readBuffer
+  ///
+  /// Kept with the connection, so a partial line from one client never
+  /// gets mixed up with another client's.
+  ///
+  std::string& commandLine() { return pendingLine; }
+
+  ///
+  /// @brief Where the next command in a ';' batch starts in commandLine()
+  ///
+  /// A line like "motorl 50;motorr -50" is handed out a command at a time.
+  /// 0 when there's no batch in progress.
+  ///
+  size_t& batchPosition() { return batchStart; }
+
+  /// @brief Is there more of a ';' batch to hand out?
+  bool inBatch() const { return batchStart != 0; }
+
+  /// @brief Forget the command line, and any batch in progress
+  void clearCommandLine()
+  {
+    pendingLine.resize( 0 );
+    batchStart = 0;
+  }
+
+  ///
+  /// @brief Send one sample as a UDP datagram
+  ///
+  /// Never blocks.  Failures are counted and otherwise ignored - the next
+  /// sample isn't far behind.
+  ///
+  /// @param[in] frame  - A whole TelemetryDatagram frame
+  /// @param[in] length - The frame length
+  ///
+  void sendTelemetryDatagram( const uint8_t* frame, size_t length )
   {
-    for ( std::streamsize index = 0; index < n; ++index )
+    if ( sendDatagramImpl( frame, length )) 
     {
-      writeBuffer.putChar( s[index] );
+      datagramsSent.increment();
+    }
+    else 
+    {
+      datagramFailures.increment();
     }
-    return n;
+  }
+
+  ///
+  /// @brief Move complete telemetry lines (or frames) into the write pipe
+  ///
+  /// Lines only move whole, and only while the write pipe holds no more
+  /// than the connection can send right now.  That keeps telemetry that
+  /// can't be sent in telemetryBuffer, where it's dropped oldest line
+  /// first, instead of going stale in writeBuffer.  Responses already in
+  /// writeBuffer go out first.
+  ///
+  /// @param[in] budget - How many characters the connection can send now
+  /// @return The number of characters moved
+  ///
+  size_t pumpTelemetry( size_t budget )
+  {
+    size_t moved = 0;
+    for ( ;; )
+    {
+      // 1. Find the end of the oldest complete line
+      const size_t lineLength = currentProtocol == NetFrame::Protocol::Binary ?
+        NetTelemetry::frameLength( telemetryBuffer ) : telemetryLineLength();
+      if ( lineLength == 0 ) { break; }
+
+      // 2. Stop if it can't go out now
+      if ( writeBuffer.available() + lineLength > budget ||
+           lineLength > writeBuffer.space() ) { break; }
+
+      // 3. Move it
+      for ( const NetTelemetryPipe::Buffer& line: telemetryBuffer.readViews( lineLength ))
+      {
+        if ( line.second == 0 ) { break; }
+        writeBuffer.write( line.first, line.second );
+      }
+      telemetryBuffer.readAdvance( lineLength );
+      moved += lineLength;
+    }
+    return moved;
   }
 
   /// 
@@ -87,8 +364,72 @@ class NetConnection: public Command::Base {
     return false;
   }
 
+  ///
+  /// @brief Get the next good frame from the read pipe
+  ///
+  /// @return true if there's a frame, which stays in frame() until the
+  ///         next call
+  ///
+  bool getFrame()
+  {
+    while ( readBuffer.available() != 0 ) 
+    {
+      if ( frameDecoder.push( static_cast<uint8_t>( readBuffer.getChar() ))) 
+      {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /// @brief The last frame getFrame found
+  const NetFrame::Decoder& frame() const { return frameDecoder; }
+
+  ///
+  /// @brief When the line (or frame) just taken from readBuffer arrived
+  ///
+  /// That's when the read that finished it landed, so time spent waiting
+  /// in readBuffer isn't counted as link time.  Asking again before the
+  /// next line is taken gives the same answer.
+  ///
+  /// @return The arrival time, or now if it wasn't stamped (i.e., there's
+  ///         no arrival clock)
+  ///
+  Time::DeviceTimeUS lineArrivedAt()
+  {
+    dropArrivalsBefore( bytesTaken() );
+    if ( arrivalsCount == 0 ) {
+      return arrivalNow();
+    }
+    return arrivals[ arrivalsHead ].at;
+  }
+
+  ///
+  /// @brief Set the clock dataReceived stamps arrivals with
+  ///
+  /// One clock for every connection.  Until it's set arrivals are 0.
+  ///
+  static void setArrivalClock( std::shared_ptr<Time::HST> hst ) 
+  { 
+    arrivalClock = hst; 
+  }
+
+  ///
+  /// @brief Set a function to call when a full line lands in readBuffer
+  ///
+  /// Used to wake up whoever reads the lines, instead of having them poll.
+  ///
+  /// @param[in] listener - The function to call
+  ///
+  void setNewLineListener( std::function<void()> listener )
+  {
+    newLineListener = listener;
+  }
+
   /// 
-  /// Called when the write FIFO is full.  Triggers a blocking write.
+  /// Called when the write FIFO is full.  Block until the client takes
+  /// some of it, or give up (i.e., after a timeout) and take none.  Taking
+  /// none hangs up on the client - see flush.
   ///
   virtual void writePushImpl( NetPipe& pipe ) = 0;
 
@@ -100,6 +441,22 @@ class NetConnection: public Command::Base {
 
   const char* debugName() { return "NetConnection"; } 
 
+  ///
+  /// Point the datagram channel at the client's port, or close it if port
+  /// is 0.  Connections without UDP only accept 0.
+  ///
+  virtual bool openDatagramImpl( uint16_t port ) { return port == 0; }
+
+  ///
+  /// Send one datagram.  Must not block.  Returns false if it wasn't sent
+  ///
+  virtual bool sendDatagramImpl( const uint8_t* data, size_t length ) 
+  { 
+    (void) data;
+    (void) length;
+    return false; 
+  }
+
   /// @brief Is the connection good?
   virtual operator bool( void ) = 0;
   /// @brief Closes the connection
@@ -108,7 +465,185 @@ class NetConnection: public Command::Base {
   public:
 
   NetPipe writeBuffer;
-  NetPipe readBuffer;
+  NetReadPipe readBuffer;
+  NetTelemetryPipe telemetryBuffer;
+
+  protected:
+
+  ///
+  /// @brief Implementations call this after adding data to readBuffer
+  ///
+  /// Stamps the read if it finished a line, for lineArrivedAt.
+  ///
+  /// @param[in] data   - The data that was added
+  /// @param[in] length - How many chars were added
+  ///
+  void dataReceived( const char_type* data, size_t length )
+  {
+    bytesArrived += static_cast<uint32_t>( length );
+
+    // Frames don't end in newlines, so any data might finish one
+    if ( currentProtocol == NetFrame::Protocol::Binary ||
+         memchr( data, '\n', length ) != nullptr ) 
+    {
+      stampArrival();
+      if ( newLineListener ) {
+        newLineListener();
+      }
+    }
+  }
+
+  private:
+
+  // Binary mode.  Collect text into lines, and send each as a Text frame.
+  // Lines longer than a frame are split.
+  void writeText( const char_type* s, size_t n )
+  {
+    for ( size_t i = 0; i < n; ++i ) 
+    {
+      if ( s[ i ] == '\n' ) 
+      {
+        flushText();
+        continue;
+      }
+      textLine[ textLength++ ] = s[ i ];
+      if ( textLength == textLine.size() ) 
+      {
+        flushText();
+      }
+    }
+  }
+
+  // Send the text collected so far as a Text frame, if there is any
+  void flushText()
+  {
+    if ( textLength == 0 ) { return; }
+    NetFrame::Buffer frame;
+    const size_t length = NetFrame::encode( NetFrame::Type::Text,
+      reinterpret_cast<const uint8_t*>( textLine.data() ), textLength, frame.data() );
+    writeBytes( reinterpret_cast<const char_type*>( frame.data() ), length );
+    textLength = 0;
+  }
+
+  // Length of the oldest complete line in telemetryBuffer, including the
+  // newline.  0 if there isn't one.
+  size_t telemetryLineLength()
+  {
+    size_t offset = 0;
+    for ( const NetTelemetryPipe::Buffer& part: telemetryBuffer.readViews( telemetryBuffer.available() ))
+    {
+      if ( part.second == 0 ) { break; }
+      const char* newLine = static_cast<const char*>( memchr( part.first, '\n', part.second ));
+      if ( newLine ) 
+      {
+        return offset + ( newLine - part.first ) + 1;
+      }
+      offset += part.second;
+    }
+    return 0;
+  }
+
+  // Arrival stamps.  One per read that might have finished a line, not
+  // one per line, so a read full of pipelined lines takes one slot.
+
+  // @brief Characters readBuffer has given out, ever.  Counts wrap.
+  uint32_t bytesTaken() const
+  {
+    return bytesArrived - static_cast<uint32_t>( readBuffer.available() );
+  }
+
+  Time::DeviceTimeUS arrivalNow() const
+  {
+    return arrivalClock ? arrivalClock->usSinceDeviceStart() : Time::DeviceTimeUS( 0 );
+  }
+
+  // Forget the reads that ended before position.  The read that ends at
+  // position is kept, since it still holds the line that was just taken.
+  void dropArrivalsBefore( uint32_t position )
+  {
+    while ( arrivalsCount != 0 && 
+            static_cast<int32_t>( arrivals[ arrivalsHead ].end - position ) < 0 ) 
+    {
+      arrivalsHead = ( arrivalsHead + 1 ) % arrivals.size();
+      --arrivalsCount;
+    }
+  }
+
+  // 1. Forget what's been read already (i.e., a new client threw the 
+  //    read pipe away)
+  // 2. Full - fold this read into the newest stamp, so its lines look
+  //    older than they are, never newer.
+  // 3. Add the stamp
+  void stampArrival()
+  {
+    // 1. Forget
+    dropArrivalsBefore( bytesTaken() );
+
+    // 2. Full
+    if ( arrivalsCount == arrivals.size() ) 
+    {
+      arrivals[ ( arrivalsHead + arrivalsCount - 1 ) % arrivals.size() ].end = bytesArrived;
+      arrivalFolds.increment();
+      return;
+    }
+
+    // 3. Add
+    arrivals[ ( arrivalsHead + arrivalsCount ) % arrivals.size() ] = { bytesArrived, arrivalNow() };
+    ++arrivalsCount;
+  }
+
+  NetTelemetry telemetryStream;
+  std::function<void()> newLineListener;
+
+  // @brief One read that might have finished a line
+  struct Arrival {
+    uint32_t end;             ///< bytesArrived at the end of the read
+    Time::DeviceTimeUS at;    ///< When the read landed
+  };
+  // @brief Stamps for reads that haven't all been taken, oldest first
+  std::array< Arrival, 8 > arrivals;
+  size_t arrivalsHead = 0;
+  size_t arrivalsCount = 0;
+  // @brief Characters dataReceived has been told about, ever.  Wraps.
+  uint32_t bytesArrived = 0;
+
+  // @brief The protocol we're speaking.  Hosts have to ask for binary
+  NetFrame::Protocol currentProtocol = NetFrame::Protocol::Ascii;
+  // @brief Binary mode - incoming frames
+  NetFrame::Decoder frameDecoder;
+  // @brief Binary mode - the text line being collected for a Text frame
+  std::array< char_type, NetFrame::maxPayload > textLine;
+  size_t textLength = 0;
+
+  // @brief The client's telemetry port, or 0 for telemetry down the stream
+  uint16_t telemetryPort = 0;
+  // @brief Does the client want telemetry at all
+  bool telemetryOn = false;
+  // @brief A command line that's still arriving, or a batch being handed
+  //        out
+  std::string pendingLine;
+  // @brief Start of the next command in a batch.  0 if there's no batch
+  size_t batchStart = 0;
+
+  // @brief The clock arrivals are stamped with
+  static inline std::shared_ptr<Time::HST> arrivalClock;
+  // @brief Reads whose stamp was folded into an older one
+  static inline Util::Metric arrivalFolds{ "Net Arrival Folds" };
+  // @brief Times the write pipe filled up and had to be pushed
+  static inline Util::Metric writePushes{ "Net Write Pushes" };
+  // @brief Clients hung up on because a push couldn't send anything
+  static inline Util::Metric stalledHangups{ "Net Stalled Hangups" };
+  // @brief Response characters lost with those clients
+  static inline Util::Metric responseDrops{ "Net Response Drops" };
+  // @brief Characters dropped because the read pipe was full.  Filling the
+  //        read pipe should never happen unless there's a bug or malice.
+  static inline Util::Metric readOverflows{ "Net Read Overflows" };
+  // @brief Telemetry lines (or frames) dropped because the link couldn't
+  //        keep up
+  static inline Util::Metric telemetryDrops{ "Net Telemetry Drops" };
+  // @brief Telemetry datagrams sent, and datagrams that couldn't be sent
+  static inline Util::Metric datagramsSent{ "Net Datagrams Sent" };
+  static inline Util::Metric datagramFailures{ "Net Datagram Failures" };
 };
 
 /// @brief Interface to the client
@@ -130,9 +665,27 @@ class NetInterface: public Command::Base {
   {
   }
 
+  /// @brief The connection the command being handled came from.  Command
+  ///        responses go here.
   virtual NetConnection& get() = 0;
   virtual std::shared_ptr<NetConnection> getShared() = 0;
 
+  ///
+  /// @brief Number of connection slots
+  ///
+  /// Interfaces that can serve several clients at once have a fixed pool.
+  /// A slot with no client in it is a connection that tests false.  The
+  /// default is the one connection get() returns.
+  ///
+  virtual size_t numConnections() { return 1; }
+  /// @brief One of the connection slots
+  virtual NetConnection& connection( size_t index ) { (void) index; return get(); }
+  /// @brief One of the connection slots, for the scheduler
+  virtual std::shared_ptr<NetConnection> connectionShared( size_t index ) { (void) index; return getShared(); }
+  /// @brief Make a slot the one get() returns, i.e., when handling its
+  ///        command
+  virtual void select( size_t index ) { (void) index; }
+
   virtual Time::TimeUS execute()=0;
 
   //virtual std::unique_ptr<NetConnection> connect( const std::string& location, unsigned int port ) = 0;
@@ -0,0 +1,111 @@
+#ifndef __NET_POLL_H__
+#define __NET_POLL_H__
+
+#include <algorithm>
+#include <cstddef>
+#include "time_types.h"
+
+///
+/// @brief Decides how often a connection polls its socket, and when to send
+///
+/// - Interval.  Any traffic, or bytes still waiting to go out, drops the
+///   poll interval to the minimum.  Every idle poll after that doubles
+///   it, up to the maximum.  An idle link costs a poll every maxInterval,
+///   and a busy link is serviced every minInterval.
+/// - Coalescing.  While a few bytes are still growing (i.e., a report
+///   going out a line at a time) they're held until there are
+///   coalesceBytes of them, they stop growing for a poll, or they've been
+///   held for coalesceWindow.  Several small writes go out as one TCP
+///   segment, and a lone response only waits one poll.  The hold time is
+///   counted in the intervals that were handed out, so it's only as
+///   accurate as the scheduler is punctual.
+///
+/// Use Example:
+///
+///   if ( poll.readyToSend( writeBuffer.available() )) { ... send ... }
+///   return poll.next( bytesMoved != 0, writeBuffer.available() != 0 );
+///
+class NetPoll
+{
+  public:
+
+  struct Options {
+    /// @brief Interval while there's traffic or data waiting to go out
+    Time::TimeUS minInterval{ 250 };
+    /// @brief Interval the link backs off to when it's idle
+    Time::TimeUS maxInterval{ 20000 };
+    /// @brief Longest a small write is held back
+    Time::TimeUS coalesceWindow{ 1000 };
+    /// @brief Send right away once this many bytes are waiting
+    size_t coalesceBytes = 128;
+  };
+
+  NetPoll() = default;
+  explicit NetPoll( const Options& optionsArg ) : options{ optionsArg } {}
+
+  ///
+  /// @brief Should the waiting bytes be sent now?
+  ///
+  /// @param[in] pending - Bytes waiting to go out
+  /// @return true to send, false to hold them for a later poll
+  ///
+  bool readyToSend( size_t pending )
+  {
+    if ( pending == 0 ) {
+      holding = false;
+      heldFor = Time::TimeUS( 0 );
+      return false;
+    }
+    if ( pending >= options.coalesceBytes || 
+         ( holding && pending == heldBytes ) ||
+         heldFor >= options.coalesceWindow ) {
+      holding = false;
+      heldFor = Time::TimeUS( 0 );
+      return true;
+    }
+    // A new hold starts its clock from zero
+    if ( !holding ) {
+      heldFor = Time::TimeUS( 0 );
+    }
+    holding = true;
+    heldBytes = pending;
+    return false;
+  }
+
+  ///
+  /// @brief Pick the time to the next poll
+  ///
+  /// @param[in] moved   - Bytes were read or written this poll
+  /// @param[in] pending - Bytes are still waiting to go out
+  /// @return Time until the next poll
+  ///
+  Time::TimeUS next( bool moved, bool pending )
+  {
+    if ( moved || pending ) {
+      interval = options.minInterval;
+    }
+    else {
+      interval = std::min( Time::TimeUS( interval * 2 ), options.maxInterval );
+    }
+    if ( holding ) {
+      interval = std::min( interval, options.coalesceWindow );
+      heldFor += interval;
+    }
+    return interval;
+  }
+
+  private:
+
+  // @brief Tunables
+  Options options;
+  // @brief The interval last handed out
+  Time::TimeUS interval{ options.minInterval };
+  // @brief Are bytes being held back to coalesce?
+  bool holding = false;
+  // @brief How long they've been held
+  Time::TimeUS heldFor{ 0 };
+  // @brief How many bytes were held at the last poll
+  size_t heldBytes = 0;
+};
+
+#endif
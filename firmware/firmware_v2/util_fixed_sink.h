@@ -0,0 +1,61 @@
+#ifndef __UTIL_FIXED_SINK__
+#define __UTIL_FIXED_SINK__
+
+#include <algorithm>  // for std::min
+#include <array>
+#include <cstring>    // for memcpy
+#include <limits>
+#include <type_traits>
+#include "simple_ostream.h"
+
+namespace Util {
+
+///
+/// @brief The most characters an integer type prints as, with its '-'
+///
+/// For sizing a FixedSink at compile time.
+///
+template< class T >
+constexpr size_t maxPrintedLength()
+{
+  return std::numeric_limits< T >::digits10 + 1 + ( std::is_signed< T >::value ? 1 : 0 );
+}
+
+///
+/// @brief A simple_ostream sink that formats into a fixed size buffer
+///
+/// For formatting something once and then copying it to several places,
+/// i.e., telemetry going to more than one client.  No allocations.  Text
+/// that doesn't fit is cut off.
+///
+/// @param[in] N - The buffer size
+///
+template< size_t N >
+class FixedSink
+{
+  public:
+
+  struct category: public beefocus_tag {};
+  using char_type = char;
+
+  std::streamsize write( const char_type* s, std::streamsize n )
+  {
+    const size_t toCopy = std::min( static_cast<size_t>( n ), N - length );
+    memcpy( &buffer[ length ], s, toCopy );
+    length += toCopy;
+    return n;
+  }
+
+  const char_type* data() const { return buffer.data(); }
+  size_t size() const { return length; }
+  void clear() { length = 0; }
+
+  private:
+
+  std::array< char_type, N > buffer;
+  size_t length = 0;
+};
+
+} // end namespace Util
+
+#endif
@@ -4,12 +4,16 @@
 #include <array>
 #include "hardware_types.h"       // For HW::PinState
 #include "time_types.h"           // For Time::DeviceTimeUS
+#include "util_metrics.h"
 
 namespace Util {
 
 /// A single event for IPinEvents
 using IPinEvent = std::pair< HW::PinState, Time::DeviceTimeUS >; 
 
+/// Events lost because an IPinEvents pipe was full, for every pin
+inline Metric pinEventOverflows{ "Pin Event Overflows" };
+
 ///
 /// @brief Record changes in an input, and the time the change occured
 ///
@@ -49,15 +53,39 @@ class IPinEvents
 {
   public:
 
+  ///
+  /// @brief Function that write() calls after it records an event
+  ///
+  /// A raw function pointer, not a std::function, because it's called from
+  /// the interrupt handler.  The function has to be OCTO_INTERRUPT_FUNC.
+  ///
+  using Listener = void (*)( void* context, const IPinEvent& event );
+
   /// @brief Constructor
   IPinEvents() :
     writeSlot{ 0 },
     readSlot{ 0 },
     writeErrorFlag{ false },
-    readErrorFlag{ false }
+    readErrorFlag{ false },
+    listener{ nullptr },
+    listenerContext{ nullptr }
   {
   }
 
+  ///
+  /// @brief Have write() call a function after every event it records
+  ///
+  /// Lets a command get woken up when an event arrives, instead of polling
+  /// for it.
+  ///
+  /// @param[in] listenerArg - The function to call, or nullptr for none
+  /// @param[in] contextArg  - Passed through to the listener
+  ///
+  void setListener( Listener listenerArg, void* contextArg ) {
+    listenerContext = contextArg;
+    listener = listenerArg;
+  }
+
   /// @brief Write an event to the pipe.  Set error flag on overflow
   /// 
   OCTO_INTERRUPT_FUNC(void) write( const IPinEvent& event ) noexcept {
@@ -72,6 +100,7 @@ class IPinEvents
     if ( readSlot == nextWriteSlot ) 
     {
       writeErrorFlag = true;
+      pinEventOverflows.increment();
       return;
     }
 
@@ -105,6 +134,10 @@ class IPinEvents
     // record the event.
     //
     events[writeSlot] = event;
+
+    if ( listener != nullptr ) {
+      listener( listenerContext, event );
+    }
   }
 
   /// @brief Are there events available to read?
@@ -143,6 +176,10 @@ class IPinEvents
   bool writeErrorFlag;
   // Set to true if we underflow on read
   bool readErrorFlag;
+  // Called after an event is recorded, if set
+  Listener listener;
+  // Passed to listener
+  void* listenerContext;
   //
   // The actual events...
   //  
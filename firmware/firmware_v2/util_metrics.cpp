@@ -0,0 +1,49 @@
+#include "util_metrics.h"
+#include "net_interface.h"
+#include "util_profile.h"   // for reportName
+
+namespace Util {
+
+Metric::Metric( const char* nameArg, Kind kindArg ) :
+  name{ nameArg },
+  kind{ kindArg },
+  value{ 0 },
+  nextMetric{ nullptr }
+{
+  // Add to the end, so the report is in definition order
+  Metric** link = &head();
+  while ( *link != nullptr ) {
+    link = &(*link)->nextMetric;
+  }
+  *link = this;
+}
+
+Metric::~Metric()
+{
+  for ( Metric** link = &head(); *link != nullptr; link = &(*link)->nextMetric ) {
+    if ( *link == this ) {
+      *link = nextMetric;
+      return;
+    }
+  }
+}
+
+void Metric::reportAll( NetInterface& net )
+{
+  auto& connection = net.get();
+  for ( const Metric* metric = first(); metric != nullptr; metric = metric->next() ) {
+    reportName( connection, metric->getName() );
+    connection << ( metric->getKind() == Kind::Counter ? "count = " : "level = " );
+    connection << static_cast<unsigned int>( metric->get() ) << "\n";
+  }
+}
+
+// Function static, so metrics that are constructed before main() still
+// find an initialized list.
+Metric*& Metric::head()
+{
+  static Metric* headMetric = nullptr;
+  return headMetric;
+}
+
+} // end namespace Util
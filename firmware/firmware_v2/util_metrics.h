@@ -0,0 +1,92 @@
+#ifndef __UTIL_METRICS__
+#define __UTIL_METRICS__
+
+#include <cstdint>
+#include "basic_types.h"    // for OCTO_INTERRUPT_FUNC
+
+class NetInterface;
+
+namespace Util {
+
+///
+/// @brief A named counter or gauge
+///
+/// For the failure counts that are otherwise invisible - dropped bytes,
+/// full pipes, unknown commands.  The stats command dumps every metric.
+///
+/// - Updates are a single 32 bit load and store to a volatile, with no 
+///   locks or allocation, so they're safe to call from an interrupt.
+///   Increments aren't atomic, so each metric should only be updated from
+///   one context (interrupt or main loop).
+/// - Metrics add themselves to a list when they're constructed.  Define
+///   them as statics (or inline variables in headers) so every user shares
+///   one metric and the list is complete before main() runs.
+///
+/// Use Example:
+///
+///   static Util::Metric droppedBytes( "Net Dropped Bytes" );
+///   droppedBytes.increment();
+///
+class Metric
+{
+  public:
+
+  enum class Kind {
+    Counter,      ///< Counts events.  Only goes up
+    Gauge         ///< A level that's set, i.e., bytes queued
+  };
+
+  ///
+  /// @brief Constructor.  Adds the metric to the list
+  ///
+  /// @param[in] nameArg - Name for the stats report.  Must outlive the 
+  ///                      metric (i.e., a string literal)
+  /// @param[in] kindArg - Counter or gauge
+  ///
+  Metric( const char* nameArg, Kind kindArg = Kind::Counter );
+  /// @brief Destructor.  Removes the metric from the list
+  ~Metric();
+  Metric( const Metric& ) = delete;
+  Metric& operator=( const Metric& ) = delete;
+
+  /// @brief Add to a counter
+  OCTO_INTERRUPT_FUNC(void) increment( uint32_t amount = 1 ) 
+  { 
+    value = value + amount; 
+  }
+
+  /// @brief Set a gauge
+  OCTO_INTERRUPT_FUNC(void) set( uint32_t newValue ) { value = newValue; }
+
+  /// @brief Current value
+  uint32_t get() const { return value; }
+
+  const char* getName() const { return name; }
+  Kind getKind() const { return kind; }
+
+  /// @brief The first metric in the list, or nullptr if there are none
+  static Metric* first() { return head(); }
+
+  /// @brief The next metric in the list, or nullptr at the end
+  Metric* next() const { return nextMetric; }
+
+  /// @brief Send every metric to net, one per line
+  static void reportAll( NetInterface& net );
+
+  private:
+
+  static Metric*& head();
+
+  // @brief The name
+  const char* const name;
+  // @brief Counter or Gauge
+  const Kind kind;
+  // @brief The count or level
+  volatile uint32_t value;
+  // @brief Next metric in the list
+  Metric* nextMetric;
+};
+
+} // end Util namespace
+
+#endif
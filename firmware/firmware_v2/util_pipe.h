@@ -1,17 +1,99 @@
 #ifndef __UTIL_PIPE__
 #define __UTIL_PIPE__
 
+#include <algorithm>  // for std::min
+#include <array>
 #include <assert.h>
-#include <functional>
+#include <cstring>    // for memcpy
+#include <utility>    // for std::forward
+#include "util_metrics.h"
 
 namespace Util {
 
+///
+/// @brief What Pipe::putChar does when the pipe is full
+///
+/// Each policy has an onFull( pipe ) that either makes room and returns
+/// true, or returns false to throw away the new character.  The pipe holds
+/// the policy by value, so the call is inlined and nothing is allocated.
+///
+namespace PipeOverflow {
+
+/// @brief Throw away the oldest character.  Optionally counts the drops
+struct DropOldest {
+  Metric* drops = nullptr;
+  template< class PipeType >
+  bool onFull( PipeType& pipe ) {
+    if ( drops ) { drops->increment(); }
+    pipe.getChar();
+    return true;
+  }
+};
+
+///
+/// @brief Throw away the oldest complete line, so whoever reads the pipe
+///        never sees half a line.  Optionally counts the lines dropped.
+///
+/// If there's no newline in the pipe the one line being written is longer
+/// than the pipe, and all of it goes.
+///
+struct DropOldestLine {
+  Metric* drops = nullptr;
+  template< class PipeType >
+  bool onFull( PipeType& pipe ) {
+    if ( drops ) { drops->increment(); }
+    for ( ;; ) {
+      const auto c = pipe.getChar();
+      if ( c == 0 || c == '\n' ) { break; }
+    }
+    return true;
+  }
+};
+
+/// @brief Throw away the new character.  Optionally counts the drops
+struct DropNewest {
+  Metric* drops = nullptr;
+  template< class PipeType >
+  bool onFull( PipeType& ) {
+    if ( drops ) { drops->increment(); }
+    return false;
+  }
+};
+
+/// @brief A full pipe is a bug
+struct Fail {
+  template< class PipeType >
+  bool onFull( PipeType& ) {
+    assert( 0 );
+    return false;
+  }
+};
+
+///
+/// @brief Have the owner empty the pipe, i.e., a blocking network write.
+///
+/// Calls owner->flush( pipe ), which has to leave at least one free slot.
+///
+template< class Owner >
+struct BlockFlush {
+  Owner* owner;
+  template< class PipeType >
+  bool onFull( PipeType& pipe ) {
+    owner->flush( pipe );
+    return true;
+  }
+};
+
+} // end namespace PipeOverflow
+
 /// @brief A classic pipe
 ///
 /// CharType - the character type.  Probably best to use char.
 /// size     - The size of the pipe.  Must be a power of 2
+/// Overflow - What putChar does when the pipe is full.  One of the 
+///            PipeOverflow policies.
 /// 
-template< class CharType, size_t size >
+template< class CharType, size_t size, class Overflow = PipeOverflow::Fail >
 class Pipe
 {
   public:
@@ -23,37 +105,44 @@ class Pipe
   static constexpr size_t indexMask = size-1;
 
   using Buffer = std::pair< CharType*, size_t >;
+  /// @brief Up to two Buffers, in order.  The second is only used when the
+  ///        data wraps around the end of the pipe, and is { nullptr, 0 }
+  ///        otherwise.  Like an iovec.
+  using Buffers = std::array< Buffer, 2 >;
 
   /// @brief Constructor
   ///
-  /// @param[in] PusherArg:  A function that gets called when the pipe is
-  ///     full.  In the case of a typical network the function would likely 
-  ///     block while it waits for the network to clear data.  That's bad.
+  /// @param[in] overflowArg - The overflow policy.  i.e., for BlockFlush
+  ///     the owner that empties the pipe.  In the case of a typical network 
+  ///     that would likely block while it waits for the network to clear 
+  ///     data.  That's bad.
   ///
-  Pipe( std::function<void(Pipe&)> pusherArg) :
-    pusher{ pusherArg },
+  explicit Pipe( Overflow overflowArg = Overflow() ) :
+    overflow{ overflowArg },
     writeIndex{ 0 },
     readIndex{ 0 }
   {
   }
 
-  Pipe() = delete;
-
   ///
   /// @brief Write a single character into the pipe
   /// 
-  /// Calls the push function if the pipe is full, which is expected
-  /// to be blocking, and probably bad.
+  /// Calls the overflow policy if the pipe is full.
+  ///
+  /// @return false if the policy threw the character away
   ///
-  void putChar( CharType c ) {
+  bool putChar( CharType c ) {
     m_buffer[ writeIndex ] = c;
     const size_t nextWriteBuffer = ( writeIndex + 1 ) & indexMask;
     if ( readIndex == nextWriteBuffer ) 
     { 
-      pusher( *this );
+      if ( !overflow.onFull( *this )) {
+        return false;
+      }
       assert( readIndex != nextWriteBuffer ); 
     }
     writeIndex = nextWriteBuffer;
+    return true;
   }
 
   ///
@@ -68,6 +157,59 @@ class Pipe
     return rval;
   }
 
+  ///
+  /// @brief Write a block of characters into the pipe
+  ///
+  /// Copies as much as fits, in at most two memcpys (up to the end of the
+  /// buffer, then from the start).  Never calls the overflow policy - if 
+  /// the return value is short, it's up to the caller to make room.
+  ///
+  /// @param[in] data   - The characters
+  /// @param[in] length - How many characters
+  /// @return How many characters were written
+  ///
+  size_t write( const CharType* data, size_t length )
+  {
+    // 1. Clip to the free space.  One slot always stays empty, so a full
+    //    pipe can be told apart from an empty one.
+    const size_t toWrite = std::min( length, space() );
+
+    // 2. Copy up to the end of the buffer, then wrap
+    const size_t firstPart = std::min( toWrite, size - writeIndex );
+    memcpy( &m_buffer[ writeIndex ], data, firstPart * sizeof( CharType ));
+    memcpy( &m_buffer[ 0 ], data + firstPart, ( toWrite - firstPart ) * sizeof( CharType ));
+
+    writeIndex = ( writeIndex + toWrite ) & indexMask;
+    return toWrite;
+  }
+
+  ///
+  /// @brief Read a block of characters from the pipe
+  ///
+  /// Same as write() but in the other direction.
+  ///
+  /// @param[out] data   - Where to put the characters
+  /// @param[in]  length - The most characters to read
+  /// @return How many characters were read
+  ///
+  size_t read( CharType* data, size_t length )
+  {
+    const size_t toRead = std::min( length, available() );
+
+    const size_t firstPart = std::min( toRead, size - readIndex );
+    memcpy( data, &m_buffer[ readIndex ], firstPart * sizeof( CharType ));
+    memcpy( data + firstPart, &m_buffer[ 0 ], ( toRead - firstPart ) * sizeof( CharType ));
+
+    readIndex = ( readIndex + toRead ) & indexMask;
+    return toRead;
+  }
+
+  /// @brief Number of characters waiting to be read
+  size_t available() const { return ( writeIndex - readIndex ) & indexMask; }
+
+  /// @brief Number of characters that can be written without a push
+  size_t space() const { return size - 1 - available(); }
+
   /// @brief Get a continous buffer for reading from
   ///
   /// @param[in] maxSize :  The maximum size of the buffer
@@ -98,6 +240,22 @@ class Pipe
     return Buffer{ &(m_buffer[readIndex]), nextReadIndex - readIndex };
   }
   
+  ///
+  /// @brief Get everything that can be read, as up to two buffers
+  ///
+  /// Same as readView, but if the data wraps around the end of the pipe 
+  /// the part at the start comes back as the second buffer, so the caller
+  /// can send it all at once.  Call readAdvance with the total used.
+  ///
+  /// @param[in] maxSize :  The maximum total size of the buffers
+  ///
+  Buffers readViews( size_t maxSize ) 
+  {
+    const size_t total = std::min( maxSize, available() );
+    const size_t firstPart = std::min( total, size - readIndex );
+    return splitViews( readIndex, firstPart, total );
+  }
+
   void readAdvance( std::size_t numToAdvance ) 
   {
     readIndex = (readIndex + numToAdvance ) & indexMask;
@@ -140,6 +298,21 @@ class Pipe
     return Buffer{ &(m_buffer[writeIndex]), nextWriteIndex - writeIndex};
   }
   
+  ///
+  /// @brief Get all the free space, as up to two buffers
+  ///
+  /// The writeView version of readViews.  Call writeAdvance with the total
+  /// written.
+  ///
+  /// @param[in] maxSize :  The maximum total size of the buffers
+  ///
+  Buffers writeViews( size_t maxSize ) 
+  {
+    const size_t total = std::min( maxSize, space() );
+    const size_t firstPart = std::min( total, size - writeIndex );
+    return splitViews( writeIndex, firstPart, total );
+  }
+
   void writeAdvance( std::size_t numToAdvance ) 
   {
     writeIndex = (writeIndex + numToAdvance ) & indexMask;
@@ -147,7 +320,22 @@ class Pipe
 
 
 private:
-  std::function<void(Pipe&)> pusher;
+
+  // total characters starting at index, of which firstPart fit before the
+  // end of the buffer.
+  Buffers splitViews( size_t index, size_t firstPart, size_t total )
+  {
+    Buffers buffers = {{ { nullptr, 0 }, { nullptr, 0 } }};
+    if ( firstPart != 0 ) {
+      buffers[ 0 ] = Buffer{ &m_buffer[ index ], firstPart };
+    }
+    if ( total != firstPart ) {
+      buffers[ 1 ] = Buffer{ &m_buffer[ 0 ], total - firstPart };
+    }
+    return buffers;
+  }
+
+  Overflow overflow;
   // index to the next character that will be written
   size_t writeIndex;
   // index to the next character that will be read.
@@ -0,0 +1,54 @@
+#include "util_probe.h"
+
+namespace Util {
+
+Probe::Probe( const char* name ) :
+  profile{ name },
+  nextProbe{ nullptr }
+{
+  // Add to the end, so the report is in the order the probes were first
+  // reached.
+  Probe** link = &head();
+  while ( *link != nullptr ) {
+    link = &(*link)->nextProbe;
+  }
+  *link = this;
+}
+
+Probe::~Probe()
+{
+  for ( Probe** link = &head(); *link != nullptr; link = &(*link)->nextProbe ) {
+    if ( *link == this ) {
+      *link = nextProbe;
+      return;
+    }
+  }
+}
+
+void Probe::setClock( std::shared_ptr<Time::HST> hstArg )
+{
+  clock() = hstArg;
+}
+
+void Probe::resetAll()
+{
+  for ( Probe* probe = first(); probe != nullptr; probe = probe->next() ) {
+    probe->profile.reset();
+  }
+}
+
+// Function statics, so probes that are constructed before main() still
+// find an initialized list.
+Probe*& Probe::head()
+{
+  static Probe* headProbe = nullptr;
+  return headProbe;
+}
+
+std::shared_ptr<Time::HST>& Probe::clock()
+{
+  static std::shared_ptr<Time::HST> probeClock;
+  return probeClock;
+}
+
+} // end namespace Util
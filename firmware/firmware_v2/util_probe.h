@@ -0,0 +1,131 @@
+#ifndef __UTIL_PROBE__
+#define __UTIL_PROBE__
+
+#include <memory>
+#include "time_hst.h"
+#include "util_profile.h"
+
+namespace Util {
+
+///
+/// @brief A named Util::Profile for timing code inside a command
+///
+/// The scheduler only profiles whole execute() calls.  Probes time the
+/// pieces - the I2C round trips, the spin loops, the math.  Every probe
+/// adds itself to a list when it's constructed, and the profile command
+/// reports the list under the per-command lines.
+///
+/// Use OCTO_PROBE_SCOPE instead of using probes directly.  It makes the
+/// probe a function static, so every call to a function shares one probe,
+/// and building with OCTO_NO_PROBES compiles the probes out completely.
+///
+/// Probes read the clock set by setClock.  Until it's set, nothing is 
+/// recorded.
+///
+class Probe
+{
+  public:
+
+  /// @brief Constructor.  Adds the probe to the list
+  ///
+  /// @param[in] name - Name for the profile report
+  ///
+  Probe( const char* name );
+  /// @brief Destructor.  Removes the probe from the list
+  ~Probe();
+  Probe( const Probe& ) = delete;
+  Probe& operator=( const Probe& ) = delete;
+
+  /// @brief Set the clock every probe uses
+  static void setClock( std::shared_ptr<Time::HST> hstArg );
+
+  /// @brief The first probe in the list, or nullptr if there are none
+  static Probe* first() { return head(); }
+
+  /// @brief The next probe in the list, or nullptr at the end
+  Probe* next() const { return nextProbe; }
+
+#ifndef OCTO_NO_PROBES
+  /// @brief Has setClock been given a clock?
+  static bool hasClock() { return clock() != nullptr; }
+
+  /// @brief Read the probe clock.  0 if there's no clock
+  static Time::DeviceTimeUS now()
+  {
+    return clock() ? clock()->usSinceDeviceStart() : Time::DeviceTimeUS( 0 );
+  }
+#endif
+
+  /// @brief Record one sample
+  void addSample( Time::TimeUS sample ) { profile.addSample( sample ); }
+
+  /// @brief The probe's samples
+  const Profile& getProfile() const { return profile; }
+
+  /// @brief Throw away every probe's samples
+  static void resetAll();
+
+  private:
+
+  static Probe*& head();
+  static std::shared_ptr<Time::HST>& clock();
+
+  // @brief The samples
+  Profile profile;
+  // @brief Next probe in the list
+  Probe* nextProbe;
+};
+
+#ifndef OCTO_NO_PROBES
+///
+/// @brief Times a scope and adds the result to a Probe
+///
+/// Nothing is added if there was no clock when the scope started, rather
+/// than a 0uS sample.
+///
+class ScopedTimer
+{
+  public:
+
+  explicit ScopedTimer( Probe& probeArg ) :
+    probe{ probeArg }, timing{ Probe::hasClock() }, start{ Probe::now() }
+  {
+  }
+
+  ~ScopedTimer()
+  {
+    if ( timing ) {
+      probe.addSample( Time::TimeUS( Probe::now() - start ));
+    }
+  }
+
+  ScopedTimer( const ScopedTimer& ) = delete;
+  ScopedTimer& operator=( const ScopedTimer& ) = delete;
+
+  private:
+
+  Probe& probe;
+  const bool timing;
+  const Time::DeviceTimeUS start;
+};
+#endif
+
+} // end Util namespace
+
+#define OCTO_PROBE_CONCAT_( a, b ) a##b
+#define OCTO_PROBE_CONCAT( a, b ) OCTO_PROBE_CONCAT_( a, b )
+
+///
+/// @brief Time from here to the end of the enclosing scope
+///
+/// @param[in] name - The probe's name, a string literal
+///
+#ifndef OCTO_NO_PROBES
+#define OCTO_PROBE_SCOPE( name ) \
+  static Util::Probe OCTO_PROBE_CONCAT( octoProbe, __LINE__ ){ name }; \
+  Util::ScopedTimer OCTO_PROBE_CONCAT( octoProbeTimer, __LINE__ ){ OCTO_PROBE_CONCAT( octoProbe, __LINE__ ) }
+#else
+#define OCTO_PROBE_SCOPE( name ) do {} while ( 0 )
+#endif
+
+#endif
@@ -1,5 +1,6 @@
-#include <numeric>
+#include <algorithm>
 #include "util_profile.h"
+#include "net_interface.h"
 #include "simple_ostream.h"
 
 namespace Util {
@@ -12,64 +13,61 @@ Profile::Profile( const std::string& binNameArg )
 
 void Profile::reset()
 {
-  currentScale = 1;
-  maxTime = Time::TimeUS{numBins};
+  count = 0;
+  binTotal = 0;
+  sum = 0;
+  maxTime = Time::TimeUS{0};
   std::fill( samples.begin(), samples.end(), 0 );
 }
 
 void Profile::addSample( Time::TimeUS sample )
 {
-  while ( sample >= maxTime ) {
-    compress();
+  const uint64_t raw = sample.get();
+  uint16_t& bin = samples[ Bins::binForSample( raw ) ];
+
+  // Out of room in the bucket.  Halve them all, so they keep their 
+  // proportions
+  if ( bin == UINT16_MAX ) {
+    binTotal = 0;
+    for ( uint16_t& halved: samples ) {
+      halved /= 2;
+      binTotal += halved;
+    }
+  }
+  ++bin;
+  ++binTotal;
+  ++count;
+  sum += raw;
+  if ( sample > maxTime ) {
+    maxTime = sample;
   }
-  size_t slot = sample.get() / currentScale;
-  samples.at( slot ) += 1;
 }
 
-void Profile::compress() 
+Time::TimeUS Profile::mean() const
 {
-  for ( size_t i = 0; i < numBins/2; ++i ) {
-    samples.at( i ) = samples.at( i*2 ) + samples.at( i*2+1 );
-  }
-  for ( size_t i = numBins/2; i < numBins; ++i ) {
-    samples.at( i ) = 0;
-  }
-  currentScale *= 2;
-  maxTime = maxTime * 2;
+  return Time::TimeUS( count == 0 ? 0 : sum / count );
 }
 
 void Profile::reportHistogram( NetInterface& net ) const
 {
   auto& connection = net.get();
   connection << "Histogram for " << binName << "\n";
-  size_t max=-1;
-  unsigned int num_samples=0;
-
-  for ( size_t i = 0; i < numBins; ++i ) {
-    if ( samples.at( i ) != 0 ) { max = i; };
-    num_samples += samples.at( i );
-  }
 
-  if ( num_samples == 0 ) {
+  if ( count == 0 ) {
     connection << "  No Samples\n";
     return;
   }
 
-  const unsigned int skip=max/20+1;
-
-  for ( unsigned int i = 0; i < 20; ++i ) {
-    const size_t start = i * skip; 
-    const size_t end   = start + skip - 1;
-    unsigned samples_here = 0;
-
-    for ( size_t index = start; index <= end; ++index ) {
-      samples_here += samples.at( index );
+  // Only the buckets that have something in them.  With a log-linear 
+  // layout most of them won't.
+  for ( size_t bin = 0; bin < numBins; ++bin ) {
+    if ( samples[ bin ] == 0 ) {
+      continue;
     }
-
-    const unsigned start_time = start * currentScale;
-    const unsigned end_time   = end   * currentScale + currentScale-1;
-
-    const unsigned percent = 100 * samples_here / num_samples; 
+    const unsigned start_time = Bins::binLowerBound( bin );
+    const unsigned end_time   = bin == numBins - 1 ? 
+      static_cast<unsigned>( maxTime.get() ) : Bins::binUpperBound( bin );
+    const unsigned percent = static_cast<unsigned>( 100ull * samples[ bin ] / binTotal ); 
 
     if ( percent < 10 )  { connection << " "; }
     if ( percent < 100 ) { connection << " "; }
@@ -80,41 +78,30 @@ void Profile::reportHistogram( NetInterface& net ) const
 void Profile::reportOneLiner( NetInterface& net ) const
 {
   auto& connection = net.get();
-  connection << binName;
-  int padding = 20 - binName.length();
+  reportName( connection, binName );
+
+  if ( count == 0 ) { connection << "No Samples\n"; return; }
+ 
+  connection << "50% = " << percentile( 500 ).get() << "uS   ";
+  connection << "90% = " << percentile( 900 ).get() << "uS   ";
+  connection << "98% = " << percentile( 980 ).get() << "uS   ";
+  connection << "99% = " << percentile( 990 ).get() << "uS   ";
+  connection << "99.9% = " << percentile( 999 ).get() << "uS   ";
+  connection << "max = " << maxTime.get() << "uS   ";
+  connection << "mean = " << mean().get() << "uS   ";
+  connection << "n = " << count << "\n";
+}
+
+void reportName( NetConnection& connection, const std::string& name )
+{
+  connection << name;
+  int padding = 20 - name.length();
   if ( padding < 0 ) padding = 0;
   for ( int i = 0; i < padding; ++i )
   {
     connection << " ";
   }
   connection << " ";
-
-  const unsigned numSamples = std::accumulate( samples.begin(), samples.end(), 0 );
-  if ( numSamples == 0 ) { connection << "No Samples\n"; return; }
- 
-  const unsigned sampleMedium = (numSamples * 50+49) / 100;
-  const unsigned sample90p    = (numSamples * 90+89) / 100;
-  const unsigned sample98p    = (numSamples * 98+97) / 100;
-  const unsigned sample100p   = numSamples;
-
-  auto timeBoundForSamples = [&]( unsigned int sample_target ) {
-    unsigned int samples_seen = 0;
-
-    for ( size_t i = 0; i < numBins; ++i ) {
-      samples_seen += samples.at( i );
-      if ( samples_seen >= sample_target ) {
-        return Time::TimeUS( i * currentScale + currentScale-1 );
-      }
-    }
-    return Time::TimeUS( numBins * currentScale );
-  };
-
-  connection << "50% = " << timeBoundForSamples( sampleMedium ).get() << "uS   ";
-  connection << "90% = " << timeBoundForSamples( sample90p ).get() << "uS   ";
-  connection << "98% = " << timeBoundForSamples( sample98p ).get() << "uS   ";
-  connection << "max = " << timeBoundForSamples( sample100p ).get() << "uS\n";
 }
 
-
 } // end namespace util
-
@@ -2,18 +2,127 @@
 #define __UTIL_PROFILE__
 
 #include <array>
+#include <cstdint>
+#include <string>
 #include "time_types.h"
-#include "net_interface.h"
+
+class NetInterface;
+class NetConnection;
 
 namespace Util {
 
-// Internal profiling tool
-//
+///
+/// @brief Log-linear (HDR style) bucket layout for microsecond samples
+///
+/// Samples below 2^(SubBucketBits+1) get a bucket each.  Above that every
+/// power of two is split into 2^SubBucketBits equal buckets, so a bucket is
+/// never more than 1/2^SubBucketBits wider than its lower bound.  Samples
+/// of 2^MaxBits or more go in the last bucket.
+///
+/// @param[in] SubBucketBits - log2 of the number of buckets per power of two
+/// @param[in] MaxBits       - log2 of the first sample that's clamped
+///
+template< unsigned int SubBucketBits, unsigned int MaxBits >
+struct LogLinearBins
+{
+  static constexpr unsigned int subBucketBits = SubBucketBits;
+  static constexpr unsigned int maxBits = MaxBits;
+  static constexpr size_t subBuckets = size_t{1} << subBucketBits;
+  static constexpr size_t numBins = ( maxBits - subBucketBits + 1 ) * subBuckets;
+
+  static_assert( maxBits < 32, "samples are binned as 32 bit numbers" );
+
+  /// @brief Which bucket a sample goes in
+  static size_t binForSample( uint64_t sample )
+  {
+    constexpr uint32_t largest = ( uint32_t{1} << maxBits ) - 1;
+    const uint32_t clamped = sample > largest ? largest : static_cast<uint32_t>( sample );
+    if ( clamped < 2 * subBuckets ) {
+      return clamped;
+    }
+    // The top subBucketBits + 1 bits pick the bucket within the power of
+    // two, and the power of two picks the group of buckets.
+    const unsigned int shift = 31 - __builtin_clz( clamped ) - subBucketBits;
+    return shift * subBuckets + ( clamped >> shift );
+  }
+
+  /// @brief The smallest sample that goes in a bucket
+  static uint32_t binLowerBound( size_t bin )
+  {
+    const unsigned int shift = binShift( bin );
+    return static_cast<uint32_t>( bin - shift * subBuckets ) << shift;
+  }
+
+  /// @brief The largest sample that goes in a bucket (the last bucket also
+  ///        gets every sample that's too large)
+  static uint32_t binUpperBound( size_t bin )
+  {
+    return binLowerBound( bin ) + ( uint32_t{1} << binShift( bin )) - 1;
+  }
+
+  ///
+  /// @brief Upper bound on the given fraction of the samples
+  ///
+  /// @param[in] counts   - Sample counts, by bucket
+  /// @param[in] total    - Total of counts
+  /// @param[in] max      - The largest sample
+  /// @param[in] perMille - Which percentile, in thousandths
+  /// @return The upper bound of the bucket the percentile falls in, capped
+  ///         at max.  0 if there are no samples
+  ///
+  template< class Counts >
+  static Time::TimeUS percentile( const Counts& counts, uint64_t total,
+                                  Time::TimeUS max, unsigned int perMille )
+  {
+    if ( total == 0 ) {
+      return Time::TimeUS( 0 );
+    }
+
+    // 1. Which sample we're looking for, rounded up
+    const uint64_t target = ( total * perMille + 999 ) / 1000;
+
+    // 2. Find the bucket it's in.  The last bucket also holds every sample
+    //    that's too big for the histogram, so the max is the better bound.
+    uint64_t seen = 0;
+    for ( size_t bin = 0; bin < numBins; ++bin ) {
+      seen += counts[ bin ];
+      if ( seen >= target && seen != 0 ) {
+        const Time::TimeUS bound( binUpperBound( bin ));
+        return bound > max || bin == numBins - 1 ? max : bound;
+      }
+    }
+    return max;
+  }
+
+  private:
+
+  static unsigned int binShift( size_t bin )
+  {
+    const size_t group = bin / subBuckets;
+    return group > 0 ? group - 1 : 0;
+  }
+};
+
+///
+/// @brief Internal profiling tool
+///
+/// A log-linear histogram of microsecond samples, with 8 buckets per power
+/// of two (12.5% error) up to 2^22uS (about 4 seconds).
+///
+/// - addSample is a count leading zeros, a shift and an increment.  The
+///   bucket layout never changes, so a big outlier doesn't throw away the
+///   resolution of the samples already recorded.
+/// - The largest sample, the sum and the count are kept exactly.
+/// - Storage is fixed at numBins 16 bit counters (320 bytes).  When one 
+///   fills up every counter is halved, so the percentiles follow the 
+///   shape of the samples, with the older ones weighted less.
+///
 class Profile
 {
   public:
 
-  static constexpr size_t numBins = 100;
+  using Bins = LogLinearBins< 3, 22 >;
+  static constexpr size_t numBins = Bins::numBins;
 
   Profile( const std::string& binNameArg );
   Profile() = delete;
@@ -23,16 +132,50 @@ class Profile
   void reportOneLiner( NetInterface& net ) const;
   void reset();
 
+  /// @brief Number of samples added since the last reset
+  unsigned int numSamples() const { return count; }
+
+  /// @brief Average sample, rounded down.  0 if there are no samples
+  Time::TimeUS mean() const;
+
+  /// @brief The largest sample.  0 if there are no samples
+  Time::TimeUS maxSample() const { return maxTime; }
+
+  ///
+  /// @brief Upper bound on the given fraction of the samples
+  ///
+  /// @param[in] perMille - Which percentile, in thousandths.  i.e., 500
+  ///                       for the median, 999 for the 99.9th percentile
+  /// @return The upper bound of the bucket the percentile falls in, capped
+  ///         at maxSample().  0 if there are no samples
+  ///
+  Time::TimeUS percentile( unsigned int perMille ) const
+  {
+    return Bins::percentile( samples, binTotal, maxTime, perMille );
+  }
+
   private:
 
-  void compress();
-  std::array< unsigned int, numBins > samples;
+  // @brief Sample counts, by bucket.  Halved when one fills up
+  std::array< uint16_t, numBins > samples;
   const std::string binName;
 
-  unsigned int currentScale = 1;
-  Time::TimeUS maxTime = Time::TimeUS{numBins};
+  // @brief Total of samples[]
+  uint32_t binTotal = 0;
+
+  // @brief Number of samples
+  unsigned int count = 0;
+  // @brief Sum of all samples, for the mean
+  uint64_t sum = 0;
+  // @brief Largest sample
+  Time::TimeUS maxTime = Time::TimeUS{0};
 };
 
+///
+/// @brief Write a name, padded out to a 20 character column
+///
+void reportName( NetConnection& connection, const std::string& name );
+
 } // end Util namespace
 
 #endif
@@ -0,0 +1,156 @@
+#ifndef __UTIL_SPSC_PIPE__
+#define __UTIL_SPSC_PIPE__
+
+#include <algorithm>  // for std::min
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include "basic_types.h"    // for OCTO_INTERRUPT_FUNC
+
+namespace Util {
+
+/// @brief How far apart to keep data that two cores write.  The ESP8266
+///        has one core and no data cache, so there it's just a word.
+#ifdef PC_BUILD
+constexpr size_t cacheLineSize = 64;
+#else
+constexpr size_t cacheLineSize = 4;
+#endif
+
+///
+/// @brief Lock-free single producer, single consumer ring
+///
+/// Util::Pipe shares plain size_t indexes between the writer and the
+/// reader, which only works because the ESP8266 has a single core and the
+/// compiler happens not to reorder anything important.  This ring is safe
+/// with the producer and consumer on different threads (sim) or with one
+/// of them in an interrupt (target).
+///
+/// - Each index is only written by one side.  The producer publishes with
+///   a release store after filling slots, and the consumer reads it with
+///   an acquire load before reading them, and vice versa.
+/// - Only loads and stores are used, no read-modify-writes, so nothing
+///   needs a lock on the ESP8266.
+/// - The two sides' indexes are on separate cache lines, and each side
+///   keeps a cached copy of the other's index so it only touches the
+///   other side's line when it looks full (or empty).
+///
+/// One slot always stays empty, so the ring holds size-1 elements.
+///
+/// @param[in] T    - The element type.  Should be trivially copyable
+/// @param[in] size - The number of slots.  Must be a power of 2
+///
+template< class T, size_t size >
+class SpscPipe
+{
+  public:
+
+  static_assert( size > 1 && ( size & ( size - 1 )) == 0, "size is not a power of 2" );
+  static constexpr size_t indexMask = size - 1;
+
+  /// @brief Producer side.  Add one element
+  ///
+  /// @return false if the ring is full (the element isn't added)
+  ///
+  OCTO_INTERRUPT_FUNC(bool) push( const T& element )
+  {
+    const size_t writeIndex = producer.index.load( std::memory_order_relaxed );
+    const size_t next = ( writeIndex + 1 ) & indexMask;
+    if ( next == producer.cachedOther ) {
+      producer.cachedOther = consumer.index.load( std::memory_order_acquire );
+      if ( next == producer.cachedOther ) {
+        return false;
+      }
+    }
+    slots[ writeIndex ] = element;
+    producer.index.store( next, std::memory_order_release );
+    return true;
+  }
+
+  /// @brief Consumer side.  Remove one element
+  ///
+  /// @param[out] element - The element, if there was one
+  /// @return false if the ring is empty
+  ///
+  OCTO_INTERRUPT_FUNC(bool) pop( T& element )
+  {
+    const size_t readIndex = consumer.index.load( std::memory_order_relaxed );
+    if ( readIndex == consumer.cachedOther ) {
+      consumer.cachedOther = producer.index.load( std::memory_order_acquire );
+      if ( readIndex == consumer.cachedOther ) {
+        return false;
+      }
+    }
+    element = slots[ readIndex ];
+    consumer.index.store( ( readIndex + 1 ) & indexMask, std::memory_order_release );
+    return true;
+  }
+
+  /// @brief Producer side.  Add as many elements as fit, in one publish
+  ///
+  /// @return The number of elements added
+  ///
+  size_t write( const T* elements, size_t length )
+  {
+    const size_t writeIndex = producer.index.load( std::memory_order_relaxed );
+    producer.cachedOther = consumer.index.load( std::memory_order_acquire );
+    const size_t space = ( producer.cachedOther - writeIndex - 1 ) & indexMask;
+    const size_t toWrite = std::min( length, space );
+
+    for ( size_t i = 0; i < toWrite; ++i ) {
+      slots[ ( writeIndex + i ) & indexMask ] = elements[ i ];
+    }
+    producer.index.store( ( writeIndex + toWrite ) & indexMask, std::memory_order_release );
+    return toWrite;
+  }
+
+  /// @brief Consumer side.  Remove as many elements as are there, up to
+  ///        length, in one publish
+  ///
+  /// @return The number of elements removed
+  ///
+  size_t read( T* elements, size_t length )
+  {
+    const size_t readIndex = consumer.index.load( std::memory_order_relaxed );
+    consumer.cachedOther = producer.index.load( std::memory_order_acquire );
+    const size_t used = ( consumer.cachedOther - readIndex ) & indexMask;
+    const size_t toRead = std::min( length, used );
+
+    for ( size_t i = 0; i < toRead; ++i ) {
+      elements[ i ] = slots[ ( readIndex + i ) & indexMask ];
+    }
+    consumer.index.store( ( readIndex + toRead ) & indexMask, std::memory_order_release );
+    return toRead;
+  }
+
+  /// @brief Elements waiting to be read.  Exact if called by the consumer,
+  ///        a lower bound otherwise
+  size_t available() const
+  {
+    return ( producer.index.load( std::memory_order_acquire ) -
+             consumer.index.load( std::memory_order_acquire )) & indexMask;
+  }
+
+  /// @brief The most elements the ring can hold
+  static constexpr size_t capacity() { return size - 1; }
+
+  private:
+
+  /// @brief One side's index, and its copy of the other side's index, on
+  ///        their own cache line
+  struct alignas( cacheLineSize ) Side {
+    std::atomic< size_t > index{ 0 };
+    size_t cachedOther = 0;
+  };
+
+  // @brief Written by push/write, read by pop/read
+  Side producer;
+  // @brief Written by pop/read, read by push/write
+  Side consumer;
+  // @brief The elements
+  alignas( cacheLineSize ) std::array< T, size > slots;
+};
+
+} // end namespace Util
+
+#endif
@@ -0,0 +1,310 @@
+#ifndef __UTIL_TIMING_WHEEL__
+#define __UTIL_TIMING_WHEEL__
+
+#include <algorithm>
+#include <array>
+#include <assert.h>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+#include "time_types.h"
+
+namespace Util {
+
+///
+/// @brief A hierarchical timing wheel, keyed on Time::DeviceTimeUS
+///
+/// A drop in replacement for the
+///
+///   std::priority_queue< std::pair< DeviceTimeUS, Index >, ..., std::greater >
+///
+/// that the scheduler uses, with the same ordering - earliest time first,
+/// ties go to the lowest index.
+///
+/// How it works:
+///
+/// - There are numLevels wheels of 64 slots.  A slot on level 0 is 1us wide,
+///   a slot on level 1 is 64us wide, a slot on level 2 is 4096us wide, etc.
+/// - An entry goes on the lowest level where it shares all the higher
+///   bits with wheelTime (the time of the last entry popped).  That means
+///   everything on level L is earlier than everything on level L+1.
+/// - Each level has a 64 bit "slot is occupied" mask, so finding the next
+///   slot is a single count-trailing-zeros.
+/// - When the lowest occupied slot is on level L > 0 its entries get
+///   "cascaded" down to the lower levels.  Every entry cascades at most
+///   numLevels times, so push and pop are O(1) (amortized for pop).
+/// - Entries more than 2^(6*numLevels) us out (19 hours) go on an overflow
+///   list.
+///
+/// Each index can only be in the wheel once, which is true for the
+/// scheduler - a command is popped, run, and pushed back.  That lets the
+/// wheel use a node per index (no allocations after the last new index
+/// is pushed) and keeps the linked lists intrusive.
+///
+/// Level 0 slot lists are kept sorted by index, which is what gives us the
+/// same tie break as the std::priority_queue.  That insert is O(number of
+/// entries with exactly the same time), which is small in practice.
+///
+/// @param[in] IndexType - A UrbanRobot::TypeSafeNumber wrapping a size_t
+///
+template< class IndexType, size_t numLevels = 6 >
+class TimingWheel
+{
+  public:
+
+  using value_type = std::pair< Time::DeviceTimeUS, IndexType >;
+
+  static constexpr unsigned int bitsPerLevel = 6;
+  static constexpr size_t slotsPerLevel = 1 << bitsPerLevel;
+  static constexpr size_t slotMask = slotsPerLevel - 1;
+
+  static_assert( numLevels * bitsPerLevel < 64, "too many levels for a 64 bit time" );
+
+  TimingWheel()
+  {
+    for ( auto& level : heads ) {
+      level.fill( noNode );
+    }
+    occupied.fill( 0 );
+  }
+
+  /// @brief Add an entry.  The entry's index can't already be in the wheel.
+  void push( const value_type& entry )
+  {
+    const size_t node = entry.second.get();
+    const unsigned long long time = entry.first.get();
+
+    if ( node >= nodes.size() ) {
+      nodes.resize( node + 1, Node{ 0, noNode, false } );
+    }
+    assert( !nodes[ node ].queued );
+
+    nodes[ node ].time = time;
+    nodes[ node ].queued = true;
+    ++count;
+
+    if ( time < wheelTime ) {
+      // Earlier than the wheel's current time.  Only happens if someone
+      // pushes after a top() cascaded the wheel forward.  Rare, slow path
+      rebase( time );
+      return;
+    }
+    place( node );
+  }
+
+  /// @brief The earliest entry.  May cascade, which is why it isn't const
+  const value_type& top()
+  {
+    assert( count != 0 );
+    const size_t node = advanceToLevel0();
+    current = value_type( Time::DeviceTimeUS( nodes[ node ].time ), IndexType( node ));
+    return current;
+  }
+
+  /// @brief Remove the earliest entry
+  void pop()
+  {
+    assert( count != 0 );
+    const size_t node = advanceToLevel0();
+    const size_t slot = nodes[ node ].time & slotMask;
+
+    heads[ 0 ][ slot ] = nodes[ node ].next;
+    if ( heads[ 0 ][ slot ] == noNode ) {
+      occupied[ 0 ] &= ~( 1ull << slot );
+    }
+    wheelTime = nodes[ node ].time;
+    nodes[ node ].queued = false;
+    --count;
+  }
+
+  ///
+  /// @brief Remove an index from the wheel, wherever it is
+  ///
+  /// @param[in] index - The index to remove
+  /// @return true if the index was in the wheel, false otherwise
+  ///
+  bool erase( IndexType index )
+  {
+    const size_t node = index.get();
+    if ( node >= nodes.size() || !nodes[ node ].queued ) {
+      return false;
+    }
+
+    // Work out which list the node is on.  Same math as place() - a node
+    // never changes levels unless its slot gets cascaded.
+    const unsigned long long time = nodes[ node ].time;
+    const uint64_t diff = time ^ wheelTime;
+    const size_t level = diff == 0 ? 0 : highestSetBit( diff ) / bitsPerLevel;
+
+    size_t* link = &overflowHead;
+    size_t slot = 0;
+    if ( level < numLevels ) {
+      slot = ( time >> ( level * bitsPerLevel )) & slotMask;
+      link = &heads[ level ][ slot ];
+    }
+    while ( *link != node ) {
+      assert( *link != noNode );
+      link = &nodes[ *link ].next;
+    }
+    *link = nodes[ node ].next;
+
+    if ( level < numLevels && heads[ level ][ slot ] == noNode ) {
+      occupied[ level ] &= ~( 1ull << slot );
+    }
+    nodes[ node ].queued = false;
+    --count;
+    return true;
+  }
+
+  bool empty() const { return count == 0; }
+  size_t size() const { return count; }
+
+  private:
+
+  static constexpr size_t noNode = std::numeric_limits<size_t>::max();
+
+  struct Node {
+    unsigned long long time;
+    size_t next;
+    bool queued;
+  };
+
+  static unsigned int lowestSetBit( uint64_t mask )
+  {
+    return __builtin_ctzll( mask );
+  }
+
+  static unsigned int highestSetBit( uint64_t mask )
+  {
+    return 63 - __builtin_clzll( mask );
+  }
+
+  //
+  // Put a node on the level that matches its distance from wheelTime
+  //
+  void place( size_t node )
+  {
+    const unsigned long long time = nodes[ node ].time;
+    const uint64_t diff = time ^ wheelTime;
+    const size_t level = diff == 0 ? 0 : highestSetBit( diff ) / bitsPerLevel;
+
+    if ( level >= numLevels ) {
+      nodes[ node ].next = overflowHead;
+      overflowHead = node;
+      return;
+    }
+
+    const size_t slot = ( time >> ( level * bitsPerLevel )) & slotMask;
+    size_t* link = &heads[ level ][ slot ];
+
+    if ( level == 0 ) {
+      // Everything in a level 0 slot has the same time.  Keep the list
+      // sorted by index so ties break the same way the heap does.
+      while ( *link != noNode && *link < node ) {
+        link = &nodes[ *link ].next;
+      }
+    }
+    nodes[ node ].next = *link;
+    *link = node;
+    occupied[ level ] |= 1ull << slot;
+  }
+
+  //
+  // Cascade higher levels down until the earliest entry is on level 0.
+  // Returns that entry.
+  //
+  size_t advanceToLevel0()
+  {
+    for ( ;; ) {
+      size_t level = 0;
+      while ( level < numLevels && occupied[ level ] == 0 ) { ++level; }
+
+      if ( level == numLevels ) {
+        refillFromOverflow();
+        continue;
+      }
+
+      const size_t slot = lowestSetBit( occupied[ level ] );
+      if ( level == 0 ) {
+        return heads[ 0 ][ slot ];
+      }
+
+      // Move the wheel to the start of the slot, then re-place everything
+      // that was in the slot.  They'll all land on lower levels.
+      const unsigned int levelShift = level * bitsPerLevel;
+      const unsigned int upperShift = levelShift + bitsPerLevel;
+      wheelTime = (( wheelTime >> upperShift ) << upperShift ) |
+                  ( static_cast<unsigned long long>( slot ) << levelShift );
+
+      size_t node = heads[ level ][ slot ];
+      heads[ level ][ slot ] = noNode;
+      occupied[ level ] &= ~( 1ull << slot );
+      while ( node != noNode ) {
+        const size_t next = nodes[ node ].next;
+        place( node );
+        node = next;
+      }
+    }
+  }
+
+  //
+  // All the levels are empty.  Jump to the earliest overflow entry and
+  // re-place the overflow list.
+  //
+  void refillFromOverflow()
+  {
+    assert( overflowHead != noNode );
+    unsigned long long earliest = std::numeric_limits<unsigned long long>::max();
+    for ( size_t node = overflowHead; node != noNode; node = nodes[ node ].next ) {
+      earliest = std::min( earliest, nodes[ node ].time );
+    }
+    wheelTime = earliest;
+
+    size_t node = overflowHead;
+    overflowHead = noNode;
+    while ( node != noNode ) {
+      const size_t next = nodes[ node ].next;
+      place( node );
+      node = next;
+    }
+  }
+
+  //
+  // Move the wheel back to an earlier time and re-place every queued node.
+  //
+  void rebase( unsigned long long time )
+  {
+    for ( auto& level : heads ) {
+      level.fill( noNode );
+    }
+    occupied.fill( 0 );
+    overflowHead = noNode;
+    wheelTime = time;
+
+    for ( size_t node = 0; node < nodes.size(); ++node ) {
+      if ( nodes[ node ].queued ) {
+        place( node );
+      }
+    }
+  }
+
+  // One node per index.  Only grows when a new index is pushed.
+  std::vector< Node > nodes;
+  // Head of each slot's linked list
+  std::array< std::array< size_t, slotsPerLevel >, numLevels > heads;
+  // Bit n is set if slot n on the level has entries
+  std::array< uint64_t, numLevels > occupied;
+  // Entries that are too far out for the top level
+  size_t overflowHead = noNode;
+  // The wheel's notion of "now".  Every entry is >= wheelTime
+  unsigned long long wheelTime = 0;
+  // Number of entries in the wheel
+  size_t count = 0;
+  // Storage for the value returned by top()
+  value_type current;
+};
+
+} // end namespace Util
+
+#endif
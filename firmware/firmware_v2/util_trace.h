@@ -0,0 +1,88 @@
+#ifndef __UTIL_TRACE__
+#define __UTIL_TRACE__
+
+#include <array>
+#include <cstdint>
+#include <cstddef>
+
+namespace Util {
+
+///
+/// @brief One command run, as recorded by the scheduler
+///
+/// The start is a full Time::DeviceTimeUS, so traces taken after hours of
+/// uptime still line up.  The lateness and duration are 32 bit offsets 
+/// from it, which keeps an event at 24 bytes on the ESP8266.
+///
+struct TraceEvent {
+  /// @brief When the command actually started
+  unsigned long long start;
+  /// @brief How late it started (start - planned).  Negative if it was early
+  int32_t late;
+  /// @brief How long it ran
+  uint32_t duration;
+  /// @brief The command's index in the scheduler
+  uint16_t index;
+
+  /// @brief When the command was supposed to start
+  unsigned long long planned() const { return start - late; }
+  /// @brief When the command finished
+  unsigned long long end() const { return start + duration; }
+};
+
+///
+/// @brief Fixed size ring buffer of TraceEvents
+///
+/// Once the buffer is full every new event overwrites the oldest one, so
+/// the buffer always holds the last N events.  No allocations, and add is
+/// a couple of stores.
+///
+/// @param[in] N - The number of events to keep
+///
+template< size_t N >
+class TraceBuffer
+{
+  public:
+
+  static_assert( N > 0, "TraceBuffer needs room for at least one event" );
+
+  /// @brief Add an event, overwriting the oldest if the buffer is full
+  void add( const TraceEvent& event )
+  {
+    events[ next ] = event;
+    next = ( next + 1 ) % N;
+    if ( count < N ) {
+      ++count;
+    }
+  }
+
+  /// @brief Number of events in the buffer
+  size_t size() const { return count; }
+
+  /// @brief Get an event.  0 is the oldest, size()-1 the newest
+  const TraceEvent& at( size_t i ) const
+  {
+    const size_t oldest = count < N ? 0 : next;
+    return events[ ( oldest + i ) % N ];
+  }
+
+  /// @brief Throw away every event
+  void reset()
+  {
+    next = 0;
+    count = 0;
+  }
+
+  private:
+
+  // The events
+  std::array< TraceEvent, N > events;
+  // Where the next event goes
+  size_t next = 0;
+  // Number of valid events
+  size_t count = 0;
+};
+
+} // end namespace Util
+
+#endif
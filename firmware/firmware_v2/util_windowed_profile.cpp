@@ -0,0 +1,102 @@
+#include <algorithm>
+#include "util_windowed_profile.h"
+#include "net_interface.h"
+#include "simple_ostream.h"
+
+namespace Util {
+
+WindowedProfile::WindowedProfile()
+{
+  reset();
+}
+
+void WindowedProfile::reset()
+{
+  for ( Slice& slice: slices ) {
+    slice.number = 0;
+    slice.count = 0;
+    slice.max = 0;
+    std::fill( slice.samples.begin(), slice.samples.end(), 0 );
+  }
+}
+
+void WindowedProfile::addSample( Time::DeviceTimeUS now, Time::TimeUS sample )
+{
+  // 1. Find the slice for this time.  If it's holding an older slice, 
+  //    those samples just left the window.
+  const uint32_t number = sliceOf( now );
+  Slice& slice = slices[ number % numSlices ];
+  if ( slice.number != number ) {
+    slice.number = number;
+    slice.count = 0;
+    slice.max = 0;
+    std::fill( slice.samples.begin(), slice.samples.end(), 0 );
+  }
+
+  // 2. Record the sample
+  uint16_t& bin = slice.samples[ Bins::binForSample( sample.get() ) ];
+  if ( bin != UINT16_MAX ) {
+    ++bin;
+  }
+  ++slice.count;
+  const uint32_t raw = sample.get() > UINT32_MAX ? UINT32_MAX : static_cast<uint32_t>( sample.get() );
+  slice.max = std::max( slice.max, raw );
+}
+
+void WindowedProfile::merge( Time::DeviceTimeUS now, Merged& merged ) const
+{
+  std::fill( merged.samples.begin(), merged.samples.end(), 0 );
+  const uint32_t number = sliceOf( now );
+
+  for ( const Slice& slice: slices ) {
+    // Skip slices that are empty or too old.  The window is the current 
+    // slice and the numSlices-1 before it.
+    if ( slice.count == 0 || number - slice.number >= numSlices ) {
+      continue;
+    }
+    for ( size_t bin = 0; bin < numBins; ++bin ) {
+      merged.samples[ bin ] += slice.samples[ bin ];
+      merged.count += slice.samples[ bin ];
+    }
+    if ( Time::TimeUS( slice.max ) > merged.max ) {
+      merged.max = Time::TimeUS( slice.max );
+    }
+  }
+}
+
+unsigned int WindowedProfile::numSamples( Time::DeviceTimeUS now ) const
+{
+  Merged merged;
+  merge( now, merged );
+  return merged.count;
+}
+
+Time::TimeUS WindowedProfile::percentile( Time::DeviceTimeUS now, unsigned int perMille ) const
+{
+  Merged merged;
+  merge( now, merged );
+  return Bins::percentile( merged.samples, merged.count, merged.max, perMille );
+}
+
+void WindowedProfile::reportOneLiner( NetInterface& net, Time::DeviceTimeUS now, const std::string& label ) const
+{
+  auto& connection = net.get();
+  reportName( connection, label );
+
+  Merged merged;
+  merge( now, merged );
+  if ( merged.count == 0 ) { connection << "No Samples\n"; return; }
+
+  auto percentile = [&merged]( unsigned int perMille ) {
+    return Bins::percentile( merged.samples, merged.count, merged.max, perMille ).get();
+  };
+  connection << "50% = " << percentile( 500 ) << "uS   ";
+  connection << "90% = " << percentile( 900 ) << "uS   ";
+  connection << "98% = " << percentile( 980 ) << "uS   ";
+  connection << "99% = " << percentile( 990 ) << "uS   ";
+  connection << "99.9% = " << percentile( 999 ) << "uS   ";
+  connection << "max = " << merged.max.get() << "uS   ";
+  connection << "n = " << merged.count << "\n";
+}
+
+} // end namespace util
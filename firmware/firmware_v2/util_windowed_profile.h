@@ -0,0 +1,103 @@
+#ifndef __UTIL_WINDOWED_PROFILE__
+#define __UTIL_WINDOWED_PROFILE__
+
+#include <array>
+#include <cstdint>
+#include "time_types.h"
+#include "util_profile.h"
+
+namespace Util {
+
+///
+/// @brief Profile of the last few seconds of samples
+///
+/// Util::Profile counts from boot (or the last reset), so a problem that 
+/// started a few seconds ago is buried under hours of normal samples.  This
+/// keeps one small histogram per 2 second slice for the last 10 seconds,
+/// and merges them when it's asked for a percentile.  The oldest slice 
+/// drops out all at once, so the window is 8 to 10 seconds long.
+///
+/// To keep the RAM cost down on the ESP8266 the histograms are coarser than
+/// Util::Profile's - 4 buckets per power of two (25% error), 16 bit counts,
+/// and samples over 2^16uS (65ms) are clamped.  The max is still exact.
+/// That's 132 bytes a slice, 660 in all.
+///
+/// Use Example:
+///
+///   Util::WindowedProfile window;
+///   window.addSample( hst->usSinceDeviceStart(), executeTime );
+///   window.percentile( hst->usSinceDeviceStart(), 990 );
+///
+class WindowedProfile
+{
+  public:
+
+  using Bins = LogLinearBins< 2, 16 >;
+  static constexpr size_t numBins = Bins::numBins;
+  static constexpr size_t numSlices = 5;
+  static constexpr unsigned int sliceUs = 2000000;
+
+  WindowedProfile();
+
+  ///
+  /// @brief Add a sample
+  ///
+  /// @param[in] now    - The time the sample was taken.  Should never go 
+  ///                     backwards.
+  /// @param[in] sample - The sample
+  ///
+  void addSample( Time::DeviceTimeUS now, Time::TimeUS sample );
+
+  /// @brief Throw away every sample
+  void reset();
+
+  ///
+  /// @brief Report the window on one line.  Same columns as 
+  ///        Util::Profile::reportOneLiner
+  ///
+  /// @param[in] net   - Where to send the report
+  /// @param[in] now   - The current time
+  /// @param[in] label - Name for the line
+  ///
+  void reportOneLiner( NetInterface& net, Time::DeviceTimeUS now, const std::string& label ) const;
+
+  /// @brief Number of samples in the window that ends at now
+  unsigned int numSamples( Time::DeviceTimeUS now ) const;
+
+  /// @brief Upper bound on a percentile (in thousandths) of the window
+  Time::TimeUS percentile( Time::DeviceTimeUS now, unsigned int perMille ) const;
+
+  private:
+
+  /// @brief One sliceUs of samples
+  struct Slice {
+    /// @brief Which slice (since device start) it holds
+    uint32_t number = 0;
+    /// @brief Number of samples
+    uint32_t count = 0;
+    /// @brief Largest sample
+    uint32_t max = 0;
+    /// @brief Sample counts by bucket.  Saturates at 65535
+    std::array< uint16_t, numBins > samples;
+  };
+
+  /// @brief Every slice in the window, merged
+  struct Merged {
+    std::array< uint32_t, numBins > samples;
+    uint32_t count = 0;
+    Time::TimeUS max = Time::TimeUS( 0 );
+  };
+
+  void merge( Time::DeviceTimeUS now, Merged& merged ) const;
+  static uint32_t sliceOf( Time::DeviceTimeUS time )
+  {
+    return static_cast<uint32_t>( time.get() / sliceUs );
+  }
+
+  // @brief The slices, indexed by number % numSlices
+  std::array< Slice, numSlices > slices;
+};
+
+} // end Util namespace
+
+#endif
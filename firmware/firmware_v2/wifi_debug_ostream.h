@@ -1,6 +1,7 @@
 #ifndef __WIFI_DEBUG_OSTREAM__
 #define __WIFI_DEBUG_OSTREAM__
 
+#include <cstring>    // for memchr
 #include "simple_ostream.h"
 #include "net_interface.h"
 #include "debug_interface.h"
@@ -21,29 +22,34 @@ class WifiDebugOstream
   {
   }
 
+  ///
+  /// @brief Write to serial as is, and to wifi with a "# " in front of 
+  ///        every non-empty line
+  ///
+  /// Goes a line at a time, so each line is one block write to the net.
+  ///
   std::streamsize write( const char_type* s, std::streamsize n )
   {
-    for ( std::streamsize i = 0; i < n; ++i )
+    m_serialDebug->write( s, n );
+
+    const char_type* end = s + n;
+    while ( s != end )
     {
-      onechar( s[i] );
+      if ( m_lastWasNewline && *s != '\n' )
+      {
+        m_wifiDebug << "# ";
+      }
+      const char_type* newLine = static_cast<const char_type*>( memchr( s, '\n', end - s ));
+      const char_type* lineEnd = newLine ? newLine + 1 : end;
+      m_wifiDebug.write( s, lineEnd - s );
+      m_lastWasNewline = ( newLine != nullptr );
+      s = lineEnd;
     }
     return n;
   }
 
   private:
 
-  void onechar(char c )
-  { 
-    m_serialDebug->write( &c, 1 );
-    bool isNewLine = ( c == '\n' );
-    if ( m_lastWasNewline && !isNewLine )
-    {
-      m_wifiDebug << "# ";
-    }
-    m_wifiDebug.write( &c, 1 );
-    m_lastWasNewline = isNewLine;
-  }
-
 
   NetConnection& m_wifiDebug;
   DebugInterface* m_serialDebug;
@@ -0,0 +1,71 @@
+///
+/// @brief Start phase scenario
+///
+/// The robot's periodic commands, with roughly the time each one takes on
+/// the ESP8266.  The encoders, gyro and data sender all run every 10ms,
+/// and the encoders and gyro do blocking I2C reads.
+///
+/// The scenario runs twice - once with every command starting at the same
+/// time, and once with period hints so the scheduler spreads the 10ms
+/// commands across the period - and reports the largest amount of work
+/// done in a single tick.
+///
+
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include "../firmware_v2/command_scheduler.h"
+#include "bench_stubs.h"
+
+namespace {
+
+struct CommandSpec {
+  const char* name;
+  unsigned int period;
+  unsigned int cost;
+};
+
+// In main.cpp's order
+const std::vector<CommandSpec> specs = {
+  { "Motor A",     100000,   20 },
+  { "Motor B",     100000,   20 },
+  { "Encoder A",    10000,  400 },
+  { "Encoder B",    10000,  400 },
+  { "SR04",         20000,  100 },
+  { "Data Sender",  10000,  600 },
+  { "Gyro",         10000,  700 },
+};
+
+Time::TimeUS runScenario( bool usePeriodHints )
+{
+  constexpr unsigned long long runTimeUs = 10000000;
+
+  auto hst = std::make_shared<BenchHST>();
+  auto scheduler = std::make_shared<Command::Scheduler>(
+      std::make_shared<NullNet>(), nullptr, std::make_shared<NullDebug>(), hst,
+      Command::Scheduler::QueueType::TimingWheel );
+
+  for ( const CommandSpec& spec : specs ) {
+    Command::ScheduleOptions options;
+    if ( usePeriodHints ) {
+      options.period = Time::TimeUS( spec.period );
+    }
+    scheduler->addCommand(
+      std::make_shared<LoadCommand>( spec.name, hst, spec.period, spec.cost ), options );
+  }
+
+  while ( hst->usSinceDeviceStart().get() < runTimeUs ) {
+    hst->advance( scheduler->execute() );
+  }
+  return scheduler->largestTick();
+}
+
+} // end anonymous namespace
+
+int main()
+{
+  std::cout << "largest tick, all start together   = " << runScenario( false ).get() << "uS\n";
+  std::cout << "largest tick, spread by period hint = " << runScenario( true ).get() << "uS\n";
+  return 0;
+}
@@ -0,0 +1,97 @@
+///
+/// @brief Scheduler priority scenario
+///
+/// A simulated robot where telemetry takes more time than the scheduler
+/// has to spare.  The encoders and gyro sample every 10ms, and the data
+/// senders and WiFi soak up most of the rest of the time.
+///
+/// The scenario runs twice - once with every command at the default
+/// priority, and once with the sampling commands at Priority::High and
+/// the telemetry at Priority::Low - and reports how far each sampling
+/// command's start times stray from its 10ms period.
+///
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../firmware_v2/command_scheduler.h"
+#include "bench_stubs.h"
+
+namespace {
+
+struct CommandSpec {
+  const char* name;
+  unsigned int period;
+  unsigned int cost;
+  Command::Priority priority;
+  bool isSampling;
+};
+
+//
+// Roughly the robot's command set, in the order main.cpp adds it, with
+// the telemetry turned way up.  The telemetry periods don't line up with
+// the sampling periods, so they drift in and out of phase.  The load
+// adds up to ~85% of the available time.
+//
+const std::vector<CommandSpec> specs = {
+  { "Motor A",       1000,   20, Command::Priority::Normal, false },
+  { "Motor B",       1000,   20, Command::Priority::Normal, false },
+  { "Encoder A",    10000,  300, Command::Priority::High,   true  },
+  { "Encoder B",    10000,  300, Command::Priority::High,   true  },
+  { "SR04",         10000,  100, Command::Priority::Normal, false },
+  { "Wifi",           900,  150, Command::Priority::Low,    false },
+  { "Data Sender 1",  4700,  900, Command::Priority::Low,    false },
+  { "Data Sender 2",  5300,  900, Command::Priority::Low,    false },
+  { "Data Sender 3",  9700, 1200, Command::Priority::Low,    false },
+  { "Gyro",         10000,  500, Command::Priority::High,   true  },
+};
+
+void runScenario( bool usePriorities )
+{
+  constexpr unsigned long long runTimeUs = 10000000;
+
+  auto hst = std::make_shared<BenchHST>();
+  auto scheduler = std::make_shared<Command::Scheduler>(
+      std::make_shared<NullNet>(), nullptr, std::make_shared<NullDebug>(), hst,
+      Command::Scheduler::QueueType::TimingWheel );
+
+  std::vector< std::shared_ptr<LoadCommand> > commands;
+  for ( const CommandSpec& spec : specs ) {
+    auto command = std::make_shared<LoadCommand>( spec.name, hst, spec.period, spec.cost );
+    Command::ScheduleOptions options;
+    options.catchUp = spec.isSampling ? Command::CatchUp::Skip : Command::CatchUp::Burst;
+    options.priority = usePriorities ? spec.priority : Command::Priority::Normal;
+    scheduler->addCommand( command, options );
+    commands.push_back( command );
+  }
+
+  while ( hst->usSinceDeviceStart().get() < runTimeUs ) {
+    hst->advance( scheduler->execute() );
+  }
+
+  std::cout << ( usePriorities ? "With priorities\n" : "All Normal priority\n" );
+  for ( size_t i = 0; i < specs.size(); ++i ) {
+    if ( !specs[ i ].isSampling ) {
+      continue;
+    }
+    double meanJitter;
+    unsigned long long maxJitter;
+    commands[ i ]->jitter( meanJitter, maxJitter );
+    std::cout << "  " << std::left << std::setw( 12 ) << specs[ i ].name << std::right
+              << " mean jitter = " << std::setw( 7 ) << std::fixed << std::setprecision( 1 ) << meanJitter
+              << "uS   max jitter = " << std::setw( 5 ) << maxJitter << "uS\n";
+  }
+}
+
+} // end anonymous namespace
+
+int main()
+{
+  runScenario( false );
+  runScenario( true );
+  return 0;
+}
@@ -0,0 +1,106 @@
+///
+/// @brief Scheduler queue benchmark
+///
+/// Runs the same set of fake commands through Command::Scheduler with the
+/// std::priority_queue backend and with the timing wheel backend, checks
+/// that both produce the same schedule, and reports the time per slice.
+///
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include "../firmware_v2/command_scheduler.h"
+#include "bench_stubs.h"
+
+namespace {
+
+///
+/// @brief A command that does nothing but ask to be called again.
+///
+/// The periods are a mix of the ones the robot uses - 0 (run again now),
+/// 50us, 1ms, 10ms, 20ms and 1s, with a bit of jitter so the commands
+/// don't all stay in lock step.
+///
+class BenchCommand: public Command::Base
+{
+  public:
+
+  BenchCommand( unsigned int idArg, std::vector<unsigned int>& logArg )
+    : id{ idArg }, log{ logArg }, seed{ idArg * 2654435761u + 1 }
+  {
+  }
+
+  Time::TimeUS execute() override
+  {
+    static constexpr unsigned int periods[] = { 0, 50, 1000, 10000, 20000, 1000000 };
+    log.push_back( id );
+    seed = seed * 1103515245u + 12345u;
+    const unsigned int period = periods[ id % 6 ];
+    const unsigned int jitter = period ? ( seed >> 16 ) % ( period / 10 + 1 ) : 0;
+    return Time::TimeUS( period + jitter );
+  }
+
+  const char* debugName() override { return "Bench"; }
+
+  private:
+
+  const unsigned int id;
+  std::vector<unsigned int>& log;
+  unsigned int seed;
+};
+
+struct BenchResult {
+  double nsPerSlice;
+  std::vector<unsigned int> order;
+};
+
+BenchResult runBench( Command::Scheduler::QueueType queueType, unsigned int numCommands, unsigned int numSlices )
+{
+  auto hst = std::make_shared<BenchHST>();
+  auto scheduler = std::make_shared<Command::Scheduler>(
+      std::make_shared<NullNet>(), nullptr, std::make_shared<NullDebug>(), hst, queueType );
+
+  BenchResult result;
+  result.order.reserve( numSlices );
+
+  for ( unsigned int i = 0; i < numCommands; ++i ) {
+    scheduler->addCommand( std::make_shared<BenchCommand>( i, result.order ));
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  for ( unsigned int slice = 0; slice < numSlices; ++slice ) {
+    hst->advance( scheduler->execute() );
+  }
+  const auto end = std::chrono::steady_clock::now();
+
+  result.nsPerSlice = std::chrono::duration<double, std::nano>( end - start ).count() / numSlices;
+  return result;
+}
+
+} // end anonymous namespace
+
+int main()
+{
+  constexpr unsigned int numSlices = 2000000;
+  bool allMatch = true;
+
+  std::cout << "commands      heap ns/slice   wheel ns/slice   same order\n";
+  for ( unsigned int numCommands : { 10, 50, 200 } )
+  {
+    const BenchResult heap  = runBench( Command::Scheduler::QueueType::Heap, numCommands, numSlices );
+    const BenchResult wheel = runBench( Command::Scheduler::QueueType::TimingWheel, numCommands, numSlices );
+    const bool same = heap.order == wheel.order;
+    allMatch = allMatch && same;
+
+    std::cout.width( 8 );
+    std::cout << numCommands;
+    std::cout.width( 18 );
+    std::cout << heap.nsPerSlice;
+    std::cout.width( 17 );
+    std::cout << wheel.nsPerSlice;
+    std::cout << "   " << ( same ? "yes" : "NO" ) << "\n";
+  }
+  return allMatch ? 0 : 1;
+}
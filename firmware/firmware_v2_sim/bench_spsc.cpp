@@ -0,0 +1,92 @@
+///
+/// @brief SPSC pipe benchmark
+///
+/// A producer thread pushes timestamps through a Util::SpscPipe to a
+/// consumer thread, which records how long each one took to arrive.  Runs
+/// once pushing one element at a time and once in blocks of 16, and
+/// reports the throughput and the latency percentiles.
+///
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "../firmware_v2/util_spsc_pipe.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using Pipe = Util::SpscPipe< int64_t, 1024 >;
+
+constexpr size_t numElements = 2000000;
+
+int64_t nowNs()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+    Clock::now().time_since_epoch() ).count();
+}
+
+void runScenario( const char* name, size_t blockSize )
+{
+  Pipe pipe;
+  std::vector< int64_t > latencies;
+  latencies.reserve( numElements );
+
+  const auto start = Clock::now();
+
+  std::thread producer( [&pipe, blockSize]() {
+    std::vector< int64_t > block( blockSize );
+    for ( size_t sent = 0; sent < numElements; ) {
+      const size_t toSend = std::min( blockSize, numElements - sent );
+      std::fill( block.begin(), block.begin() + toSend, nowNs() );
+      size_t done = 0;
+      while ( done < toSend ) {
+        const size_t wrote = pipe.write( block.data() + done, toSend - done );
+        if ( wrote == 0 ) {
+          // Full.  Let the consumer run if it's sharing our core
+          std::this_thread::yield();
+        }
+        done += wrote;
+      }
+      sent += toSend;
+    }
+  });
+
+  std::vector< int64_t > block( blockSize );
+  while ( latencies.size() < numElements ) {
+    const size_t got = pipe.read( block.data(), blockSize );
+    if ( got == 0 ) {
+      std::this_thread::yield();
+      continue;
+    }
+    const int64_t now = nowNs();
+    for ( size_t i = 0; i < got; ++i ) {
+      latencies.push_back( now - block[ i ] );
+    }
+  }
+  producer.join();
+
+  const std::chrono::duration<double> elapsed = Clock::now() - start;
+  std::sort( latencies.begin(), latencies.end() );
+  auto percentile = [&latencies]( unsigned int perMille ) {
+    return latencies[ ( latencies.size() - 1 ) * perMille / 1000 ];
+  };
+
+  std::cout << name << ": " << numElements / elapsed.count() / 1e6 << "M elements/s"
+            << ", latency 50% " << percentile( 500 ) << "ns"
+            << " 99% " << percentile( 990 ) << "ns"
+            << " 99.9% " << percentile( 999 ) << "ns"
+            << " max " << latencies.back() << "ns\n";
+}
+
+} // end anonymous namespace
+
+int main()
+{
+  runScenario( "push/pop one at a time", 1 );
+  runScenario( "write/read blocks of 16", 16 );
+  return 0;
+}
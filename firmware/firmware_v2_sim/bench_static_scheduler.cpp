@@ -0,0 +1,177 @@
+///
+/// @brief Command::StaticScheduler vs. Command::Scheduler benchmark
+///
+/// Runs the same fake commands through the compile time scheduler and the
+/// regular scheduler, checks that both produce the same schedule, and
+/// reports the time per slice.
+///
+/// Built three ways.  bench_static_scheduler runs both schedulers.  The
+/// bench_static_scheduler_dynamic_only and bench_static_scheduler_static_only
+/// builds only link one scheduler in, so their sizes can be compared.
+///
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "../firmware_v2/command_static_scheduler.h"
+#ifndef BENCH_STATIC_ONLY
+#include "../firmware_v2/command_scheduler.h"
+#endif
+#include "bench_stubs.h"
+
+namespace {
+
+///
+/// @brief A command that does nothing but ask to be called again.
+///
+/// Same periods as bench_scheduler.  Each id is its own type, so the
+/// static scheduler gets a parameter pack of different commands.
+///
+template< unsigned int id >
+class BenchCommand: public Command::Base
+{
+  public:
+
+  BenchCommand( std::vector<unsigned int>& logArg )
+    : log{ logArg }, seed{ id * 2654435761u + 1 }
+  {
+  }
+
+  Time::TimeUS execute() override
+  {
+    static constexpr unsigned int periods[] = { 0, 50, 1000, 10000, 20000, 1000000 };
+    log.push_back( id );
+    seed = seed * 1103515245u + 12345u;
+    const unsigned int period = periods[ id % 6 ];
+    const unsigned int jitter = period ? ( seed >> 16 ) % ( period / 10 + 1 ) : 0;
+    return Time::TimeUS( period + jitter );
+  }
+
+  const char* debugName() override { return "Bench"; }
+
+  private:
+
+  std::vector<unsigned int>& log;
+  unsigned int seed;
+};
+
+// Sampling style options on every third command, and a period hint on
+// every fourth, so the catch up, priority and phase paths get used too.
+Command::ScheduleOptions benchOptions( size_t index )
+{
+  Command::ScheduleOptions options;
+  if ( index % 3 == 2 ) {
+    options.catchUp = Command::CatchUp::Skip;
+    options.priority = Command::Priority::High;
+  }
+  if ( index % 4 == 1 ) {
+    options.period = Time::TimeUS( 10000 );
+  }
+  return options;
+}
+
+struct BenchResult {
+  double nsPerSlice;
+  std::vector<unsigned int> order;
+};
+
+template< class Scheduler >
+void timeSlices( BenchResult& result, Scheduler& scheduler, BenchHST& hst, unsigned int numSlices )
+{
+  const auto start = std::chrono::steady_clock::now();
+  for ( unsigned int slice = 0; slice < numSlices; ++slice ) {
+    hst.advance( scheduler.execute() );
+  }
+  const auto end = std::chrono::steady_clock::now();
+  result.nsPerSlice = std::chrono::duration<double, std::nano>( end - start ).count() / numSlices;
+}
+
+#ifndef BENCH_STATIC_ONLY
+template< size_t... ids >
+BenchResult runDynamic( std::index_sequence< ids... >, unsigned int numSlices )
+{
+  BenchResult result;
+  result.order.reserve( numSlices );
+
+  auto hst = std::make_shared<BenchHST>();
+  Command::Scheduler scheduler(
+      std::make_shared<NullNet>(), nullptr, std::make_shared<NullDebug>(), hst,
+      Command::Scheduler::QueueType::Heap );
+
+  ( scheduler.addCommand( std::make_shared< BenchCommand< ids > >( result.order ),
+                          benchOptions( ids )), ... );
+
+  timeSlices( result, scheduler, *hst, numSlices );
+  return result;
+}
+#endif
+
+#ifndef BENCH_DYNAMIC_ONLY
+template< size_t... ids >
+BenchResult runStatic( std::index_sequence< ids... >, unsigned int numSlices )
+{
+  BenchResult result;
+  result.order.reserve( numSlices );
+
+  auto hst = std::make_shared<BenchHST>();
+  std::tuple< BenchCommand< ids >... > commands{ BenchCommand< ids >( result.order )... };
+  Command::StaticScheduler< BenchCommand< ids >... > scheduler(
+      hst, std::get< ids >( commands )... );
+
+  ( scheduler.setOptions( ids, benchOptions( ids )), ... );
+
+  timeSlices( result, scheduler, *hst, numSlices );
+  return result;
+}
+#endif
+
+template< size_t numCommands >
+bool runBoth( unsigned int numSlices )
+{
+  using Ids = std::make_index_sequence< numCommands >;
+
+  std::cout.width( 8 );
+  std::cout << numCommands;
+
+#ifndef BENCH_STATIC_ONLY
+  const BenchResult dynamic = runDynamic( Ids(), numSlices );
+  std::cout.width( 20 );
+  std::cout << dynamic.nsPerSlice;
+#else
+  std::cout.width( 20 );
+  std::cout << "-";
+#endif
+
+#ifndef BENCH_DYNAMIC_ONLY
+  const BenchResult fixed = runStatic( Ids(), numSlices );
+  std::cout.width( 19 );
+  std::cout << fixed.nsPerSlice;
+#else
+  std::cout.width( 19 );
+  std::cout << "-";
+#endif
+
+#if !defined( BENCH_STATIC_ONLY ) && !defined( BENCH_DYNAMIC_ONLY )
+  const bool same = dynamic.order == fixed.order;
+  std::cout << "   " << ( same ? "yes" : "NO" ) << "\n";
+  return same;
+#else
+  std::cout << "   -\n";
+  return true;
+#endif
+}
+
+} // end anonymous namespace
+
+int main()
+{
+  constexpr unsigned int numSlices = 2000000;
+
+  std::cout << "commands   Scheduler ns/slice   Static ns/slice   same order\n";
+  const bool match10 = runBoth< 10 >( numSlices );
+  const bool match50 = runBoth< 50 >( numSlices );
+  return match10 && match50 ? 0 : 1;
+}
@@ -0,0 +1,140 @@
+#ifndef __BENCH_STUBS_H__
+#define __BENCH_STUBS_H__
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include "../firmware_v2/command_base.h"
+#include "../firmware_v2/debug_interface.h"
+#include "../firmware_v2/net_interface.h"
+#include "../firmware_v2/time_hst.h"
+
+///
+/// @brief Stand ins for the hardware, shared by the scheduler benchmarks
+///
+
+///
+/// @brief HST that only moves when the benchmark moves it.
+///
+class BenchHST: public Time::HST
+{
+  public:
+
+  Time::DeviceTimeMS msSinceDeviceStart() override
+  {
+    return Time::DeviceTimeMS( now / 1000 );
+  }
+
+  Time::DeviceTimeUS usSinceDeviceStart() override
+  {
+    return Time::DeviceTimeUS( now );
+  }
+
+  Time::TimeUS execute() override { return Time::TimeUS( 1000000 ); }
+  const char* debugName() override { return "Bench HST"; }
+
+  void advance( Time::TimeUS delay ) { now += delay.get(); }
+
+  private:
+
+  unsigned long long now = 0;
+};
+
+class NullConnection: public NetConnection {
+  public:
+
+  operator bool(void) override { return true; }
+  void reset(void ) override {}
+
+  void writePushImpl( NetPipe& pipe ) override {
+    while ( pipe.getChar() ) {}
+  }
+
+  Time::TimeUS execute() override { return Time::TimeUS( 1000 ); }
+};
+
+class NullNet: public NetInterface {
+  public:
+
+  const char* debugName() override { return "NullNet"; }
+  Time::TimeUS execute() override { return Time::TimeUS( 1000 ); }
+  NetConnection& get() override { return connection; }
+  std::shared_ptr<NetConnection> getShared() override { return nullptr; }
+
+  private:
+
+  NullConnection connection;
+};
+
+class NullDebug: public DebugInterface
+{
+  public:
+
+  std::streamsize write( const char_type*, std::streamsize n ) override { return n; }
+  void disable() override {}
+};
+
+///
+/// @brief A command that takes a fixed amount of (simulated) time
+///
+/// The cost varies by up to +/- 50% from call to call, the way sending
+/// a line of telemetry does.  Records its start times so the benchmark
+/// can work out the jitter.
+///
+class LoadCommand: public Command::Base
+{
+  public:
+
+  LoadCommand(
+    const char* nameArg,
+    std::shared_ptr<BenchHST> hstArg,
+    unsigned int periodArg,
+    unsigned int costArg )
+    : name{ nameArg }, hst{ hstArg }, period{ periodArg }, cost{ costArg },
+      seed{ periodArg * 2654435761u + costArg }
+  {
+  }
+
+  Time::TimeUS execute() override
+  {
+    starts.push_back( hst->usSinceDeviceStart().get() );
+    seed = seed * 1103515245u + 12345u;
+    const unsigned int variation = ( seed >> 16 ) % ( cost + 1 );
+    hst->advance( Time::TimeUS( cost / 2 + variation ));
+    return Time::TimeUS( period );
+  }
+
+  const char* debugName() override { return name; }
+
+  ///
+  /// @brief How far the time between starts strays from the period
+  ///
+  /// @param[out] meanJitter - Average |interval - period| in us
+  /// @param[out] maxJitter  - Largest |interval - period| in us
+  ///
+  void jitter( double& meanJitter, unsigned long long& maxJitter ) const
+  {
+    double total = 0;
+    maxJitter = 0;
+    for ( size_t i = 1; i < starts.size(); ++i ) {
+      const long long interval = starts[ i ] - starts[ i - 1 ];
+      const long long error = interval - period;
+      const unsigned long long absError = error < 0 ? -error : error;
+      total += absError;
+      maxJitter = std::max( maxJitter, absError );
+    }
+    meanJitter = starts.size() > 1 ? total / ( starts.size() - 1 ) : 0;
+  }
+
+  private:
+
+  const char* name;
+  std::shared_ptr<BenchHST> hst;
+  const unsigned int period;
+  const unsigned int cost;
+  unsigned int seed;
+  std::vector<unsigned long long> starts;
+};
+
+#endif
@@ -0,0 +1,151 @@
+///
+/// @brief Host side round trip latency client
+///
+/// Sends "ping <hostTime>" to the robot (or the simulator) one at a time
+/// and takes each round trip apart with the device times in the reply:
+///
+///   PONG <hostTime> <received> <dispatched> <replied>
+///
+///   scheduler - received to dispatched.  From the line landing in the
+///               device's read pipe to starting the command, i.e., the 
+///               wait for ProcessCommand to be scheduled, and behind the
+///               rest of a ';' batch
+///   command   - dispatched to replied.  Running the command
+///   link      - the rest of the round trip.  The network, both ways, and
+///               the time the reply waits in the device's write pipe
+///
+/// To try it against the simulator:
+///
+///   firmware_v2_sim --tcp &
+///   latency_client 127.0.0.1 4999 1000
+///
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+namespace {
+
+long long nowUs()
+{
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+    std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+// Reads a line at a time from a socket
+class LineReader
+{
+  public:
+
+  explicit LineReader( int fdArg ) : fd{ fdArg } {}
+
+  bool getLine( std::string& line )
+  {
+    for (;;) {
+      const size_t newLine = buffer.find( '\n' );
+      if ( newLine != std::string::npos ) {
+        line = buffer.substr( 0, newLine );
+        buffer.erase( 0, newLine + 1 );
+        return true;
+      }
+      char block[ 1024 ];
+      const ssize_t length = recv( fd, block, sizeof( block ), 0 );
+      if ( length <= 0 ) {
+        return false;
+      }
+      buffer.append( block, length );
+    }
+  }
+
+  private:
+
+  int fd;
+  std::string buffer;
+};
+
+void report( const char* name, std::vector< long long >& samples )
+{
+  std::sort( samples.begin(), samples.end() );
+  auto percentile = [&samples]( unsigned int perMille ) {
+    return samples[ ( samples.size() - 1 ) * perMille / 1000 ];
+  };
+  std::cout << name
+            << " 50% " << percentile( 500 ) << "us"
+            << " 90% " << percentile( 900 ) << "us"
+            << " 99% " << percentile( 990 ) << "us"
+            << " max " << samples.back() << "us\n";
+}
+
+} // end anonymous namespace
+
+int main( int argc, char* argv[] )
+{
+  if ( argc != 4 ) {
+    std::cerr << "Usage: " << argv[ 0 ] << " <address> <port> <pings>\n";
+    return 1;
+  }
+  const size_t numPings = strtoul( argv[ 3 ], nullptr, 10 );
+
+  sockaddr_in address = {};
+  address.sin_family = AF_INET;
+  address.sin_port = htons( static_cast<uint16_t>( atoi( argv[ 2 ] )));
+  const int fd = socket( AF_INET, SOCK_STREAM, 0 );
+  if ( inet_pton( AF_INET, argv[ 1 ], &address.sin_addr ) != 1 || fd < 0 ||
+       connect( fd, reinterpret_cast<const sockaddr*>( &address ), sizeof( address )) != 0 ) {
+    std::cerr << "Could not connect to " << argv[ 1 ] << " " << argv[ 2 ] << "\n";
+    return 1;
+  }
+  const int noDelay = 1;
+  setsockopt( fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof( noDelay ));
+
+  // 1. Ping, one at a time.  Skip the comments and anything that isn't
+  //    the PONG for this ping
+  LineReader reader( fd );
+  std::vector< long long > roundTrip, scheduler, command, link;
+  std::string line;
+  for ( size_t i = 0; i < numPings; ++i ) {
+    const long long sent = nowUs() & 0x7fffffff;
+    const std::string ping = "ping " + std::to_string( sent ) + "\n";
+    if ( send( fd, ping.data(), ping.size(), 0 ) != static_cast<ssize_t>( ping.size() )) {
+      std::cerr << "Lost the connection\n";
+      return 1;
+    }
+
+    long long hostTime = -1, received = 0, dispatched = 0, replied = 0;
+    while ( hostTime != sent ) {
+      if ( !reader.getLine( line )) {
+        std::cerr << "Lost the connection\n";
+        return 1;
+      }
+      std::istringstream pong( line );
+      std::string word;
+      pong >> word >> hostTime >> received >> dispatched >> replied;
+      if ( word != "PONG" || !pong ) {
+        hostTime = -1;
+      }
+    }
+
+    const long long total = (( nowUs() & 0x7fffffff ) - sent + 0x80000000LL ) & 0x7fffffff;
+    roundTrip.push_back( total );
+    scheduler.push_back( dispatched - received );
+    command.push_back( replied - dispatched );
+    link.push_back( total - ( replied - received ));
+  }
+  close( fd );
+
+  // 2. Report
+  report( "round trip", roundTrip );
+  report( "link      ", link );
+  report( "scheduler ", scheduler );
+  report( "command   ", command );
+  return 0;
+}
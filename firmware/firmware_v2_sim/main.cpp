@@ -1,7 +1,14 @@
 
+#include <algorithm>
 #include <iostream>
 #include <memory>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
 #include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
 #include <time.h>
 #include <math.h>   // for adding variation to simulated temperature.
 #include <map>
@@ -16,22 +23,35 @@
 #include "../firmware_v2/time_interface.h"
 #include "../firmware_v2/time_manager.h"
 #include "../firmware_v2/time_hst.h"
+#include "../firmware_v2/util_probe.h"
+#include "net_posix.h"
 
-std::shared_ptr<Command::Scheduler> scheduler;
-
-class TimeInterfaceSim: public Time::Interface {
-  public:
- 
-  Time::RealTimeS secondsSince1970() override {
-    return Time::RealTimeS(time(nullptr));
-  } 
-
-};
+class SimTimeHST;
 
+std::shared_ptr<Command::Scheduler> scheduler;
+std::shared_ptr<SimTimeHST> simHst;
+std::shared_ptr<NetInterface> simNet;
+
+///
+/// @brief Simulator High Speed Timer
+///
+/// Has two modes.
+///
+/// Real Time    - Reads CLOCK_MONOTONIC.  The main loop sleeps for the
+///                delay the scheduler asks for.
+/// Virtual Time - A counter that the main loop advances by the delay the
+///                scheduler asks for, instead of sleeping.  Runs as fast as
+///                the host can go, and runs the same way every time.
+///
+/// In Virtual Time every clock read also moves the clock forward by 1us.
+/// That gives the commands a small, repeatable execution time, and keeps
+/// code that spins on the clock (i.e., SR04::sendPulse) from spinning
+/// forever.
+///
 class SimTimeHST: public Time::HST 
 {
   public:
-  SimTimeHST() 
+  SimTimeHST( bool virtualTimeArg ) : virtualTime{ virtualTimeArg }
   {
     startTime = Time::DeviceTimeMS(0);
     startTime = msSinceDeviceStart();    // side effects.
@@ -41,6 +61,9 @@ class SimTimeHST: public Time::HST
 
   Time::DeviceTimeMS msSinceDeviceStart() override 
   {
+    if ( virtualTime ) {
+      return Time::DeviceTimeMS( virtualNowUs++ / 1000 - startTime.get() );
+    }
     timespec t;
     clock_gettime(CLOCK_MONOTONIC, &t );
     const unsigned int msFromS  = t.tv_sec * 1000;
@@ -50,6 +73,9 @@ class SimTimeHST: public Time::HST
 
   Time::DeviceTimeUS usSinceDeviceStart() override 
   {
+    if ( virtualTime ) {
+      return Time::DeviceTimeUS( virtualNowUs++ - startTimeUs.get() );
+    }
     timespec t;
     clock_gettime(CLOCK_MONOTONIC, &t );
     const unsigned long int usFromS  = t.tv_sec * 1000000;
@@ -66,15 +92,67 @@ class SimTimeHST: public Time::HST
     return "Sim High Speed Timer";
   }
 
+  /// @brief Is the timer running on virtual time?
+  bool isVirtual() const { return virtualTime; }
+
+  ///
+  /// @brief Wait for the delay the scheduler returned
+  ///
+  /// Virtual time moves the clock forward.  Real time sleeps.
+  ///
+  /// @param[in] delay - The delay
+  ///
+  void wait( Time::TimeUS delay )
+  {
+    if ( virtualTime ) {
+      virtualNowUs += delay.get();
+    }
+    else {
+      usleep( delay.get() );
+    }
+  }
+
   private:
 
+  const bool virtualTime;
+  unsigned long long virtualNowUs = 0;
   Time::DeviceTimeMS startTime;
   Time::DeviceTimeUS startTimeUs;
 };
 
+///
+/// @brief Simulator wall clock
+///
+/// Uses the host's clock in real time.  In virtual time the clock starts
+/// at a fixed date (2021-01-01) and follows the high speed timer, so runs
+/// repeat exactly.
+///
+class TimeInterfaceSim: public Time::Interface {
+  public:
+
+  TimeInterfaceSim( std::shared_ptr<SimTimeHST> hstArg ) : hst{ hstArg } {}
+ 
+  Time::RealTimeS secondsSince1970() override {
+    if ( hst->isVirtual() ) {
+      constexpr unsigned int virtualEpoch = 1609459200;
+      return Time::RealTimeS( virtualEpoch + hst->msSinceDeviceStart().get() / 1000 );
+    }
+    return Time::RealTimeS(time(nullptr));
+  } 
+
+  private:
+
+  std::shared_ptr<SimTimeHST> hst;
+};
+
 class NetConnectionSim: public NetConnection {
   public:
 
+  ~NetConnectionSim() 
+  {
+    openDatagramImpl( 0 );
+  }
+
   operator bool(void) {
     return true;
   }
@@ -83,14 +161,18 @@ class NetConnectionSim: public NetConnection {
   {
   }
 
-  void writePushImpl( NetPipe&) override {
-    // should never happen
-    assert(0);
+  // The write buffer is full.  Flush it to stdout, like the ESP8266
+  // connection flushes to its socket.
+  void writePushImpl( NetPipe& pipe ) override {
+    flush( pipe );
   }
 
   Time::TimeUS execute() override {
-    while ( char c = writeBuffer.getChar() ) {
-      putchar(c);
+    // Responses, then as much telemetry as there is.  stdout never pushes
+    // back.
+    flush( writeBuffer );
+    while ( pumpTelemetry( writeBuffer.space() ) != 0 ) {
+      flush( writeBuffer );
     }
 
     fd_set readfds;
@@ -100,19 +182,60 @@ class NetConnectionSim: public NetConnection {
     timeout.tv_sec = 0;
     timeout.tv_usec = 0;
 
+    // Whatever's waiting on stdin, as is, like the ESP8266 reads its
+    // socket.  One read, so it can't block.
     FD_SET(STDIN_FILENO, &readfds );
-    while ( select(1, &readfds, nullptr, nullptr, &timeout ))
+    if ( select(1, &readfds, nullptr, nullptr, &timeout ) > 0 )
     {
-      std::string input;
-      std::cin >> input;
-      for ( auto& charIn : input ) {
-        readBuffer.putChar( charIn );
+      const NetReadPipe::Buffer inBuf = readBuffer.writeViews( readBuffer.space() )[ 0 ];
+      const ssize_t numRead = inBuf.second == 0 ? 0 : read( STDIN_FILENO, inBuf.first, inBuf.second );
+      if ( numRead > 0 ) {
+        readBuffer.writeAdvance( numRead );
+        dataReceived( inBuf.first, numRead );
       }
-      readBuffer.putChar( '\n' );
     }
 
     return Time::TimeUS( 50 );
   }
+
+  // The host is always this machine, so telemetry datagrams go to
+  // localhost.
+  bool openDatagramImpl( uint16_t port ) override {
+    if ( datagramSocket >= 0 ) {
+      close( datagramSocket );
+      datagramSocket = -1;
+    }
+    if ( port == 0 ) {
+      return true;
+    }
+    datagramSocket = socket( AF_INET, SOCK_DGRAM, 0 );
+    if ( datagramSocket < 0 ) {
+      return false;
+    }
+    memset( &datagramAddress, 0, sizeof( datagramAddress ));
+    datagramAddress.sin_family = AF_INET;
+    datagramAddress.sin_port = htons( port );
+    datagramAddress.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+    return true;
+  }
+
+  bool sendDatagramImpl( const uint8_t* data, size_t length ) override {
+    const ssize_t sent = sendto( datagramSocket, data, length, MSG_DONTWAIT, 
+      reinterpret_cast<const sockaddr*>( &datagramAddress ), sizeof( datagramAddress ));
+    return sent == static_cast<ssize_t>( length );
+  }
+
+  private:
+
+  int datagramSocket = -1;
+  sockaddr_in datagramAddress;
+
+  static void flush( NetPipe& pipe ) {
+    char block[ 256 ];
+    while ( size_t length = pipe.read( block, sizeof( block ))) {
+      fwrite( block, 1, length, stdout );
+    }
+  }
 };
 
 class NetInterfaceSim: public NetInterface {
@@ -206,7 +329,8 @@ class ISim: public I
 
   int WireAvailable(int i2c_bus) override
   {
-    return(0);
+    // Always have data, so the encoder doesn't spin forever waiting for it
+    return(1);
   }
 
   int WireRequestFrom(int i2c_bus, int address, int quantity) override
@@ -240,23 +364,43 @@ Time::TimeUS loop() {
   return scheduler->execute();
 }
 
-void setup() {
+//
+// tcpPort == 0 talks to the console, otherwise the simulator is a TCP
+// server like the robot.
+//
+bool setup( bool virtualTime, uint16_t tcpPort ) {
   auto debug      = std::make_shared<DebugInterfaceSim>();
-  auto wifi       = std::make_shared<NetInterfaceSim>( debug );
+  std::shared_ptr<NetInterface> wifi;
+  if ( tcpPort == 0 ) {
+    wifi = std::make_shared<NetInterfaceSim>( debug );
+  }
+  else {
+    auto server = std::make_shared<NetInterfacePosix>( debug, tcpPort );
+    if ( !server->listening() ) {
+      std::cerr << "Could not listen on port " << tcpPort << "\n";
+      return false;
+    }
+    wifi = server;
+  }
   auto hardware   = std::make_shared<HW::ISim>();
-  auto hst        = std::make_shared<SimTimeHST>();
+  auto hst        = std::make_shared<SimTimeHST>( virtualTime );
+  simHst          = hst;
+  simNet          = wifi;
+  Util::Probe::setClock( hst );
+  NetConnection::setArrivalClock( hst );
 
   scheduler = std::make_shared<Command::Scheduler>( 
-                          wifi, hardware, debug, hst );
+                          wifi, hardware, debug, hst,
+                          Command::Scheduler::QueueType::TimingWheel );
 
-  auto timeSim    = std::make_shared<TimeInterfaceSim>();
+  auto timeSim    = std::make_shared<TimeInterfaceSim>( hst );
   auto time       = std::make_shared<Time::Manager>( timeSim, hst );
   auto motorSimA  = std::make_shared<Command::Motor>( hardware, debug, 0); //0 for first motor, 1 for second motor
   auto motorSimB  = std::make_shared<Command::Motor>( hardware, debug, 1);
   auto encoderASim = std::make_shared<Command::Encoder>(
-                          hardware, debug, wifi, 0);
+                          hardware, debug, wifi, hst, 0);
   auto encoderBSim = std::make_shared<Command::Encoder>(
-                          hardware, debug, wifi, 1);
+                          hardware, debug, wifi, hst, 1);
  
   auto sr04        = std::make_shared<Command::SR04> (
                           hardware, debug, wifi, hst,
@@ -267,7 +411,7 @@ void setup() {
 
   auto dataSend = std::make_shared<Command::DataSend>( 
                           debug, wifi, 
-                          encoderASim, encoderBSim, sr04, hardware );
+                          encoderASim, encoderBSim, sr04, gyro, hardware, hst );
 
   auto commandProcessor= std::make_shared<Command::ProcessCommand>( 
                           wifi, hardware, debug, 
@@ -281,26 +425,155 @@ void setup() {
                           dataSend
   );
 
+  // Sensors - a late sample is worth less than a sample on time, and
+  // sampling goes ahead of everything else when the scheduler is behind.
+  // The encoders and gyro run every 10ms.
+  Command::ScheduleOptions sampling;
+  sampling.catchUp = Command::CatchUp::Skip;
+  sampling.priority = Command::Priority::High;
+  sampling.budget = Time::TimeUS( 1000 );
+  sampling.period = Time::TimeUS( 10000 );
+
+  // Telemetry - can wait for the sensors.  Also every 10ms, so it gets
+  // spread out with the sensors.
+  Command::ScheduleOptions telemetry;
+  telemetry.catchUp = Command::CatchUp::Skip;
+  telemetry.priority = Command::Priority::Low;
+  telemetry.budget = Time::TimeUS( 2000 );
+  telemetry.period = Time::TimeUS( 10000 );
+
+  Command::ScheduleOptions background;
+  background.priority = Command::Priority::Low;
+
   scheduler->addCommand( commandProcessor );
   scheduler->addCommand( time );
   scheduler->addCommand( hst );
   scheduler->addCommand( motorSimA );
   scheduler->addCommand( motorSimB );
   scheduler->addCommand( sr04 );
-  scheduler->addCommand( gyro );
-  scheduler->addCommand( encoderASim );
-  scheduler->addCommand( encoderBSim );
-  scheduler->addCommand( wifi );
-  scheduler->addCommand( dataSend );
+  scheduler->addCommand( gyro, sampling );
+  scheduler->addCommand( encoderASim, sampling );
+  scheduler->addCommand( encoderBSim, sampling );
+  scheduler->addCommand( wifi, background );
+  scheduler->addCommand( dataSend, telemetry );
+  if ( tcpPort != 0 ) {
+    // Each client polls on its own schedule, like on the robot
+    for ( size_t i = 0; i < wifi->numConnections(); ++i ) {
+      scheduler->addCommand( wifi->connectionShared( i ));
+    }
+  }
+
+  // Event driven wakeups
+  for ( size_t i = 0; i < wifi->numConnections(); ++i ) {
+    wifi->connection( i ).setNewLineListener( 
+      [commandProcessor]() { scheduler->wake( *commandProcessor ); } );
+  }
+  return true;
+}
+
+///
+/// @brief Write the scheduler's trace as Chrome trace_event JSON
+///
+/// Load the file in chrome://tracing or https://ui.perfetto.dev.  Each
+/// command gets its own track, and each run is a slice with the planned
+/// start time and lateness as arguments.
+///
+/// @param[in] fileName - Where to write the trace
+///
+void writeChromeTrace( const char* fileName )
+{
+  std::ofstream out( fileName );
+  if ( !out ) {
+    std::cerr << "Could not open trace file " << fileName << "\n";
+    return;
+  }
+
+  // 1. Name each command's track
+  const char* separator = "\n";
+  out << "{\"traceEvents\":[";
+  for ( size_t index = 0; index < scheduler->numCommands(); ++index ) 
+  {
+    out << separator << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << index
+        << ",\"args\":{\"name\":\"" << scheduler->commandName( index ) << "\"}}";
+    separator = ",\n";
+  }
+
+  // 2. One complete event per command run
+  const Command::Scheduler::Trace& trace = scheduler->getTrace();
+  for ( size_t i = 0; i < trace.size(); ++i ) 
+  {
+    const Util::TraceEvent& event = trace.at( i );
+    out << separator << "{\"name\":\"" << scheduler->commandName( event.index ) 
+        << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.index
+        << ",\"ts\":" << event.start
+        << ",\"dur\":" << event.duration
+        << ",\"args\":{\"planned\":" << event.planned()
+        << ",\"late\":" << std::max( event.late, 0 ) << "}}";
+    separator = ",\n";
+  }
+  out << "\n]}\n";
+}
+
+void usage( const char* name )
+{
+  std::cerr << "Usage: " << name << " [--virtual-time] [--run-for <seconds>] [--trace <file>]\n";
+  std::cerr << "       [--tcp] [--port <port>]\n";
+  std::cerr << "  --virtual-time       Run on a virtual clock, as fast as possible\n";
+  std::cerr << "  --run-for <seconds>  Stop after <seconds> of robot time and print top\n";
+  std::cerr << "  --trace <file>       With --run-for, write the last scheduler slices\n";
+  std::cerr << "                       to <file> as Chrome trace_event JSON\n";
+  std::cerr << "  --tcp                Serve TCP clients on port 4999, like the robot,\n";
+  std::cerr << "                       instead of the console\n";
+  std::cerr << "  --port <port>        Serve TCP clients on <port>\n";
 }
 
 int main(int argc, char* argv[])
 {
-  setup();
+  bool virtualTime = false;
+  unsigned long long runForUs = 0;
+  const char* traceFile = nullptr;
+  uint16_t tcpPort = 0;
+
+  for ( int arg = 1; arg < argc; ++arg ) 
+  {
+    if ( strcmp( argv[ arg ], "--virtual-time" ) == 0 ) {
+      virtualTime = true;
+    }
+    else if ( strcmp( argv[ arg ], "--run-for" ) == 0 && arg + 1 < argc ) {
+      runForUs = strtoull( argv[ ++arg ], nullptr, 10 ) * 1000000;
+    }
+    else if ( strcmp( argv[ arg ], "--trace" ) == 0 && arg + 1 < argc ) {
+      traceFile = argv[ ++arg ];
+    }
+    else if ( strcmp( argv[ arg ], "--tcp" ) == 0 ) {
+      tcpPort = tcpPort != 0 ? tcpPort : 4999;
+    }
+    else if ( strcmp( argv[ arg ], "--port" ) == 0 && arg + 1 < argc ) {
+      tcpPort = static_cast<uint16_t>( atoi( argv[ ++arg ] ));
+    }
+    else {
+      usage( argv[ 0 ] );
+      return 1;
+    }
+  }
+
+  if ( !setup( virtualTime, tcpPort )) {
+    return 1;
+  }
   for ( ;; ) 
   {
     Time::TimeUS delay = loop();
-    usleep( delay.get() );
+    simHst->wait( delay );
+    if ( runForUs != 0 && simHst->usSinceDeviceStart().get() >= runForUs ) {
+      break;
+    }
+  }
+
+  // Report where the time went, and flush it out
+  scheduler->dumpTop();
+  simNet->get().execute();
+  if ( traceFile != nullptr ) {
+    writeChromeTrace( traceFile );
   }
   return 0;
 }
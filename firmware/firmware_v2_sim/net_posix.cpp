@@ -0,0 +1,280 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include "net_posix.h"
+#include "../firmware_v2/util_metrics.h"
+
+namespace {
+const char* const noFreeSlots = "# No free slots - Dropping Your Connection.\n";
+Util::Metric bytesSent( "Net Bytes Sent" );
+Util::Metric bytesReceived( "Net Bytes Received" );
+Util::Metric writeCalls( "Net Write Calls" );
+// Every slot shares the gauge.  Idle slots return before setting it, so it
+// shows the last client polled
+Util::Metric pollInterval( "Net Poll Interval", Util::Metric::Kind::Gauge );
+
+// How long writePushImpl waits for the client to take some data
+constexpr int pushTimeoutMs = 1000;
+
+bool setNonBlocking( int fd )
+{
+  const int flags = fcntl( fd, F_GETFL, 0 );
+  return flags >= 0 && fcntl( fd, F_SETFL, flags | O_NONBLOCK ) == 0;
+}
+
+} // end anonymous namespace
+
+// ==========================================================================
+
+NetConnectionPosix::~NetConnectionPosix()
+{
+  reset();
+}
+
+//
+// Same starting point as a new client on the robot - ASCII, no telemetry,
+// and nothing left over from the slot's last client.
+//
+void NetConnectionPosix::initConnection( int socketArg )
+{
+  reset();
+  clientSocket = socketArg;
+  setNonBlocking( clientSocket );
+  const int noDelay = 1;
+  setsockopt( clientSocket, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof( noDelay ));
+
+  setProtocol( NetFrame::Protocol::Ascii );
+  setTelemetryPort( 0 );
+  setWantsTelemetry( false );
+  poll = NetPoll();
+  readBuffer.readAdvance( readBuffer.available() );
+  writeBuffer.readAdvance( writeBuffer.available() );
+  (*this) << "# Urban Octo Robot is ready for commands\n";
+}
+
+void NetConnectionPosix::reset()
+{
+  openDatagramImpl( 0 );
+  if ( clientSocket >= 0 )
+  {
+    close( clientSocket );
+    clientSocket = -1;
+  }
+}
+
+//
+// The room left in the kernel's send buffer - what availableForWrite is
+// on the robot.
+//
+size_t NetConnectionPosix::sendWindow()
+{
+  int bufferSize = 0;
+  socklen_t length = sizeof( bufferSize );
+  int queued = 0;
+  if ( getsockopt( clientSocket, SOL_SOCKET, SO_SNDBUF, &bufferSize, &length ) != 0 ||
+       ioctl( clientSocket, TIOCOUTQ, &queued ) != 0 ||
+       queued >= bufferSize )
+  {
+    return 0;
+  }
+  return bufferSize - queued;
+}
+
+size_t NetConnectionPosix::send( NetPipe& pipe, size_t limit )
+{
+  size_t written = 0;
+  for ( const NetPipe::Buffer& outBuf: pipe.readViews( limit ))
+  {
+    if ( outBuf.second == 0 ) { break; }
+    const ssize_t accepted = ::send( clientSocket, outBuf.first, outBuf.second,
+      MSG_DONTWAIT | MSG_NOSIGNAL );
+    if ( accepted <= 0 ) { break; }
+    written += accepted;
+    if ( static_cast<size_t>( accepted ) != outBuf.second ) { break; }
+  }
+  pipe.readAdvance( written );
+  bytesSent.increment( written );
+  return written;
+}
+
+//
+// The write pipe is full of command responses.  Like the robot, wait for
+// the client to take some of it.  If it's gone away or stopped reading
+// nothing is taken, and NetConnection::flush hangs up.
+//
+void NetConnectionPosix::writePushImpl( NetPipe& pipe )
+{
+  if ( clientSocket >= 0 )
+  {
+    pollfd writable = { clientSocket, POLLOUT, 0 };
+    if ( ::poll( &writable, 1, pushTimeoutMs ) > 0 )
+    {
+      send( pipe, pipe.available() );
+    }
+  }
+}
+
+//
+// Telemetry goes to the client's address, like the robot.
+//
+bool NetConnectionPosix::openDatagramImpl( uint16_t port )
+{
+  if ( datagramSocket >= 0 )
+  {
+    close( datagramSocket );
+    datagramSocket = -1;
+  }
+  if ( port == 0 )
+  {
+    return true;
+  }
+  socklen_t length = sizeof( datagramAddress );
+  if ( clientSocket < 0 ||
+       getpeername( clientSocket, reinterpret_cast<sockaddr*>( &datagramAddress ), &length ) != 0 )
+  {
+    return false;
+  }
+  datagramAddress.sin_port = htons( port );
+  datagramSocket = socket( AF_INET, SOCK_DGRAM, 0 );
+  return datagramSocket >= 0;
+}
+
+bool NetConnectionPosix::sendDatagramImpl( const uint8_t* data, size_t length )
+{
+  const ssize_t sent = sendto( datagramSocket, data, length, MSG_DONTWAIT,
+    reinterpret_cast<const sockaddr*>( &datagramAddress ), sizeof( datagramAddress ));
+  return sent == static_cast<ssize_t>( length );
+}
+
+//
+// 1. Read whatever the client sent.  0 from recv means it hung up
+// 2. Top up the write pipe with telemetry
+// 3. Send, unless it's a few bytes worth holding for company
+// 4. Pick the next poll
+//
+Time::TimeUS NetConnectionPosix::execute()
+{
+  if ( clientSocket < 0 )
+  {
+    return Time::TimeUS( 20000 );
+  }
+  size_t moved = 0;
+
+  // 1. Read
+  for ( const NetReadPipe::Buffer& inBuf: readBuffer.writeViews( readBuffer.space() ))
+  {
+    if ( inBuf.second == 0 ) { break; }
+    const ssize_t numRead = recv( clientSocket, inBuf.first, inBuf.second, MSG_DONTWAIT );
+    if ( numRead == 0 || ( numRead < 0 && errno != EAGAIN && errno != EWOULDBLOCK ))
+    {
+      reset();
+      return Time::TimeUS( 20000 );
+    }
+    if ( numRead < 0 ) { break; }
+    readBuffer.writeAdvance( numRead );
+    bytesReceived.increment( numRead );
+    moved += numRead;
+    dataReceived( inBuf.first, numRead );
+    if ( static_cast<size_t>( numRead ) != inBuf.second ) { break; }
+  }
+
+  // 2. Telemetry.  Only what fits in the socket's send buffer, so a client
+  //    that stops reading loses telemetry, not responses.  pumpTelemetry
+  //    leaves room for the responses already waiting
+  pumpTelemetry( std::min( sendWindow(), writeBuffer.space() ));
+
+  // 3. Send
+  if ( poll.readyToSend( writeBuffer.available() ))
+  {
+    moved += send( writeBuffer, writeBuffer.available() );
+    writeCalls.increment();
+  }
+
+  // 4. Next poll
+  const Time::TimeUS next = poll.next( moved != 0, writeBuffer.available() != 0 );
+  pollInterval.set( next.get() );
+  return next;
+}
+
+// ==========================================================================
+
+NetInterfacePosix::NetInterfacePosix(
+  std::shared_ptr<DebugInterface> debugArg,
+  uint16_t port
+)
+  : log{ debugArg }
+{
+  for ( auto& connection: connections )
+  {
+    connection = std::make_shared<NetConnectionPosix>();
+  }
+
+  listenSocket = socket( AF_INET, SOCK_STREAM, 0 );
+  const int reuse = 1;
+  sockaddr_in address = {};
+  address.sin_family = AF_INET;
+  address.sin_port = htons( port );
+  address.sin_addr.s_addr = htonl( INADDR_ANY );
+  if ( listenSocket < 0 ||
+       setsockopt( listenSocket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof( reuse )) != 0 ||
+       bind( listenSocket, reinterpret_cast<const sockaddr*>( &address ), sizeof( address )) != 0 ||
+       listen( listenSocket, maxClients ) != 0 ||
+       !setNonBlocking( listenSocket ))
+  {
+    (*log) << "Could not listen on port " << port << "\n";
+    if ( listenSocket >= 0 )
+    {
+      close( listenSocket );
+      listenSocket = -1;
+    }
+    return;
+  }
+  (*log) << "Listening on port " << port << "\n";
+}
+
+NetInterfacePosix::~NetInterfacePosix()
+{
+  if ( listenSocket >= 0 )
+  {
+    close( listenSocket );
+  }
+}
+
+//
+// New clients get the first free slot.  If every slot is taken the new
+// client is told so and hung up on.
+//
+Time::TimeUS NetInterfacePosix::execute()
+{
+  for ( ;; )
+  {
+    const int client = listenSocket < 0 ? -1 : accept( listenSocket, nullptr, nullptr );
+    if ( client < 0 )
+    {
+      break;
+    }
+    (*log) << "New client connecting\n";
+
+    auto freeSlot = std::find_if( connections.begin(), connections.end(),
+      []( const std::shared_ptr<NetConnectionPosix>& connection ) {
+        return !*connection;
+      });
+    if ( freeSlot != connections.end() )
+    {
+      (*freeSlot)->initConnection( client );
+    }
+    else
+    {
+      ::send( client, noFreeSlots, strlen( noFreeSlots ), MSG_DONTWAIT | MSG_NOSIGNAL );
+      close( client );
+    }
+  }
+  return Time::TimeUS{ 10 * 1000 };
+}
@@ -0,0 +1,119 @@
+#ifndef __NET_POSIX_H__
+#define __NET_POSIX_H__
+
+#include <array>
+#include <memory>
+#include <netinet/in.h>
+#include "../firmware_v2/debug_interface.h"
+#include "../firmware_v2/net_interface.h"
+#include "../firmware_v2/net_poll.h"
+
+///
+/// @brief One TCP client of the simulator
+///
+/// The POSIX version of WifiConnectionEthernet.  Non-blocking sockets,
+/// the same pipes, and the same polling - so a host program sees the
+/// simulator the way it sees the robot.
+///
+class NetConnectionPosix: public NetConnection {
+  public:
+
+  NetConnectionPosix() = default;
+  ~NetConnectionPosix() override;
+  NetConnectionPosix( const NetConnectionPosix& ) = delete;
+  NetConnectionPosix& operator=( const NetConnectionPosix& ) = delete;
+
+  ///
+  /// @brief Take over a newly accepted client
+  ///
+  /// @param[in] socketArg - The client's socket.  The connection closes it
+  ///
+  void initConnection( int socketArg );
+
+  /// @brief Hang up on the client, if there is one
+  void reset() override;
+
+  operator bool( void ) override { return clientSocket >= 0; }
+
+  Time::TimeUS execute() override;
+  const char* debugName() override { return "NetConnectionPosix"; }
+
+  void writePushImpl( NetPipe& pipe ) override;
+  bool openDatagramImpl( uint16_t port ) override;
+  bool sendDatagramImpl( const uint8_t* data, size_t length ) override;
+
+  private:
+
+  ///
+  /// @brief Send as much of a pipe as the socket takes without blocking
+  ///
+  /// @param[in] pipe  - What to send
+  /// @param[in] limit - Send at most this much
+  /// @return Bytes sent
+  ///
+  size_t send( NetPipe& pipe, size_t limit );
+
+  /// @brief Room in the socket's send buffer
+  size_t sendWindow();
+
+  // @brief The client's socket.  -1 if the slot is free
+  int clientSocket = -1;
+  // @brief Socket for telemetry datagrams.  -1 if there isn't one
+  int datagramSocket = -1;
+  // @brief The client's address, with the telemetry port
+  sockaddr_in datagramAddress = {};
+  // @brief Poll rate and small write coalescing
+  NetPoll poll;
+};
+
+///
+/// @brief A TCP server for the simulator
+///
+/// Listens on a port (4999, like the robot, by default) and serves a
+/// fixed pool of clients, the same way WifiInterfaceEthernet does.  The
+/// connections are scheduled on their own; this command only accepts new
+/// clients.
+///
+class NetInterfacePosix: public NetInterface {
+  public:
+
+  ///
+  /// @brief Constructor.  Starts listening
+  ///
+  /// @param[in] debugArg - Debug log
+  /// @param[in] port     - TCP port to listen on
+  ///
+  NetInterfacePosix( std::shared_ptr<DebugInterface> debugArg, uint16_t port );
+  ~NetInterfacePosix() override;
+
+  /// @brief Is the server listening?
+  bool listening() const { return listenSocket >= 0; }
+
+  const char* debugName() override { return "NetInterfacePosix"; }
+  Time::TimeUS execute() override;
+
+  NetConnection& get() override { return *connections[ current ]; }
+  std::shared_ptr<NetConnection> getShared() override { return connections[ current ]; }
+  size_t numConnections() override { return maxClients; }
+  NetConnection& connection( size_t index ) override { return *connections[ index ]; }
+  std::shared_ptr<NetConnection> connectionShared( size_t index ) override
+  {
+    return connections[ index ];
+  }
+  void select( size_t index ) override { current = index; }
+
+  private:
+
+  // @brief How many clients can be connected at once.  Same as the robot
+  static constexpr size_t maxClients = 3;
+
+  std::shared_ptr<DebugInterface> log;
+  // @brief The listening socket.  -1 if it couldn't be opened
+  int listenSocket = -1;
+  // @brief One connection per client slot.  A slot that tests false is free
+  std::array< std::shared_ptr<NetConnectionPosix>, maxClients > connections;
+  // @brief The slot get() returns - whoever sent the current command
+  size_t current = 0;
+};
+
+#endif
@@ -0,0 +1,109 @@
+///
+/// @brief Host side UDP telemetry listener
+///
+/// Listens for the robot's (or the simulator's) telemetry datagrams and
+/// reports how many were lost or arrived out of order, and the jitter -
+/// how far each packet's arrival drifts from the device's own timestamp,
+/// relative to the earliest packet.  That's one way latency with the
+/// unknown clock offset taken out.
+///
+/// To try it against the simulator:
+///
+///   telemetry_listener 5000 1000 &
+///   firmware_v2_sim            (then type "udp 5000" and "datasend 1")
+///
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "../firmware_v2/net_frame.h"
+
+namespace {
+
+long long nowUs()
+{
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+    std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+} // end anonymous namespace
+
+int main( int argc, char* argv[] )
+{
+  if ( argc != 3 ) {
+    std::cerr << "Usage: " << argv[ 0 ] << " <port> <packets>\n";
+    return 1;
+  }
+  const uint16_t port = static_cast<uint16_t>( atoi( argv[ 1 ] ));
+  const size_t numPackets = strtoul( argv[ 2 ], nullptr, 10 );
+
+  const int fd = socket( AF_INET, SOCK_DGRAM, 0 );
+  sockaddr_in address = {};
+  address.sin_family = AF_INET;
+  address.sin_port = htons( port );
+  address.sin_addr.s_addr = htonl( INADDR_ANY );
+  if ( fd < 0 || bind( fd, reinterpret_cast<const sockaddr*>( &address ), sizeof( address )) != 0 ) {
+    std::cerr << "Could not listen on port " << port << "\n";
+    return 1;
+  }
+
+  // 1. Collect packets.  Arrival minus device time is the latency plus a
+  //    constant clock offset.
+  std::vector< long long > offsets;
+  uint32_t highestSequence = 0;
+  size_t received = 0;
+  size_t reordered = 0;
+  size_t badPackets = 0;
+  while ( received < numPackets ) {
+    uint8_t packet[ NetFrame::maxFrame ];
+    const ssize_t length = recv( fd, packet, sizeof( packet ), 0 );
+    const long long arrival = nowUs();
+
+    NetFrame::Decoder decoder;
+    bool good = false;
+    for ( ssize_t i = 0; i < length && !good; ++i ) {
+      good = decoder.push( packet[ i ] );
+    }
+    if ( !good || decoder.type() != NetFrame::Type::TelemetryDatagram ) {
+      ++badPackets;
+      continue;
+    }
+
+    const NetFrame::TelemetryDatagram datagram = NetFrame::TelemetryDatagram::decode( decoder.payload() );
+    if ( received != 0 && datagram.sequence < highestSequence ) {
+      ++reordered;
+    }
+    highestSequence = std::max( highestSequence, datagram.sequence );
+    offsets.push_back( arrival - datagram.deviceTimeUs );
+    ++received;
+  }
+  close( fd );
+
+  // 2. Report.  The smallest offset is the best guess at the clock offset
+  //    plus the minimum latency.
+  const long long best = *std::min_element( offsets.begin(), offsets.end() );
+  for ( long long& offset : offsets ) {
+    offset -= best;
+  }
+  std::sort( offsets.begin(), offsets.end() );
+  auto percentile = [&offsets]( unsigned int perMille ) {
+    return offsets[ ( offsets.size() - 1 ) * perMille / 1000 ];
+  };
+
+  const size_t sent = highestSequence + 1;
+  std::cout << "received " << received << " of " << sent << " sent"
+            << ", lost " << ( sent > received ? sent - received : 0 )
+            << ", reordered " << reordered
+            << ", bad " << badPackets << "\n";
+  std::cout << "jitter 50% " << percentile( 500 ) << "us"
+            << " 99% " << percentile( 990 ) << "us"
+            << " max " << offsets.back() << "us\n";
+  return 0;
+}
@@ -1,6 +1,6 @@
 #include <gtest/gtest.h>
 
-#include "../firmware_v1/command_parser.h"
+#include "../firmware_v2/command_parser.h"
 #include "test_mock_debug.h"
 #include "test_mock_event.h"
 #include "test_mock_hardware.h"
@@ -24,6 +24,59 @@ TEST( COMMAND_PARSER, should_process_int )
   ASSERT_EQ( process_int( std::string("REL_POS=-500") , 8 ), -500 );
 }
 
+TEST( COMMAND_PARSER, should_keep_partial_lines_per_connection )
+{
+  NetMockSimpleConnection alice;
+  NetMockSimpleConnection bob;
+
+  // Both clients are part way through a command
+  alice.readBuffer.write( "moto", 4 );
+  bob.readBuffer.write( "pi", 2 );
+  ASSERT_EQ( CommandPacket(), checkForCommands( alice ));
+  ASSERT_EQ( CommandPacket(), checkForCommands( bob ));
+
+  // and finish them in the other order
+  bob.readBuffer.write( "ng\n", 3 );
+  alice.readBuffer.write( "rl 50\n", 6 );
+  ASSERT_EQ( CommandPacket( Command::Ping ), checkForCommands( bob ));
+  ASSERT_EQ( CommandPacket( Command::SetMotorL, 50 ), checkForCommands( alice ));
+}
+
+TEST( COMMAND_PARSER, should_hand_out_a_batch_a_command_at_a_time )
+{
+  NetMockSimpleConnection connection;
+  connection.readBuffer.write( "MotorL 50; motorr -50;bogus;ping\nmotora 7\n", 42 );
+
+  ASSERT_EQ( CommandPacket( Command::SetMotorL, 50 ), checkForCommands( connection ));
+  ASSERT_TRUE( connection.inBatch() );
+  ASSERT_EQ( CommandPacket( Command::SetMotorR, -50 ), checkForCommands( connection ));
+  ASSERT_EQ( CommandPacket( Command::BadCommand ), checkForCommands( connection ));
+  ASSERT_EQ( CommandPacket( Command::Ping ), checkForCommands( connection ));
+  ASSERT_FALSE( connection.inBatch() );
+
+  // The next line isn't part of the batch
+  ASSERT_EQ( CommandPacket( Command::SetMotorA, 7 ), checkForCommands( connection ));
+  ASSERT_EQ( CommandPacket(), checkForCommands( connection ));
+}
+
+TEST( COMMAND_PARSER, should_read_request_tags_and_ping_times )
+{
+  NetMockSimpleConnection connection;
+  const char* input = "ping\nping garbage\nping 12345\n@7 motorl -5;@8 ping 9;encoderl\n@3 bogus\n";
+  connection.readBuffer.write( input, strlen( input ));
+
+  ASSERT_EQ( CommandPacket( Command::Ping ), checkForCommands( connection ));
+  ASSERT_EQ( CommandPacket( Command::Ping ), checkForCommands( connection ));
+  ASSERT_EQ( CommandPacket( Command::Ping, 12345 ), checkForCommands( connection ));
+  ASSERT_EQ( CommandPacket( Command::SetMotorL, -5, 7 ), checkForCommands( connection ));
+  ASSERT_EQ( CommandPacket( Command::Ping, 9, 8 ), checkForCommands( connection ));
+  ASSERT_EQ( CommandPacket( Command::GetEncoderL ), checkForCommands( connection ));
+
+  // A bad command keeps its tag, so the host still hears back
+  ASSERT_EQ( CommandPacket( Command::BadCommand, NoArg, 3 ), checkForCommands( connection ));
+  ASSERT_EQ( CommandPacket(), checkForCommands( connection ));
+}
+
 #ifdef TODO
 TEST( COMMAND_PARSER, checkForCommands)
 {
@@ -1,6 +1,6 @@
 #include <gtest/gtest.h>
 
-#include "../firmware_v1/hardware_interface.h"
+#include "../firmware_v2/hardware_interface.h"
 #include "../firmware_v2/wifi_secrets.h"
 
 /// @brief Every Pin in the Pins enum should have a debug name
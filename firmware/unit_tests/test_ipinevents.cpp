@@ -4,7 +4,7 @@
 /// @brief Tests for Util::IPinEvents
 ///
 
-#include "../firmware_v1/util_ipinevents.h"
+#include "../firmware_v2/util_ipinevents.h"
 
 namespace Util {
 
@@ -95,6 +95,7 @@ TEST( pipe_should, write_to_full )
 TEST( pipe_should, error_on_write_fail )
 {
   IPinEvents<4, 0> events;
+  const uint32_t overflowsBefore = pinEventOverflows.get();
   
   // Size 4 pipe can only hold 3 events, so feed it four events
   const std::vector<IPinEvent> golden = {
@@ -107,8 +108,9 @@ TEST( pipe_should, error_on_write_fail )
     events.write( event );
   }
 
-  // Should have error
+  // Should have error, and the overflow should be counted
   ASSERT_EQ( true , events.hasWriteError() );
+  ASSERT_EQ( overflowsBefore + 1, pinEventOverflows.get() );
 
   // First three events should be there - forth was lost.
   for( std::size_t i = 0; i < 3; ++i ) {
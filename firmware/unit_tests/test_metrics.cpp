@@ -0,0 +1,54 @@
+#include <gtest/gtest.h>
+
+#include <memory>
+
+#include "../firmware_v2/util_metrics.h"
+
+namespace Util {
+
+namespace {
+bool isRegistered( const Metric& target )
+{
+  for ( Metric* metric = Metric::first(); metric != nullptr; metric = metric->next() ) {
+    if ( metric == &target ) {
+      return true;
+    }
+  }
+  return false;
+}
+}
+
+TEST( metric_should, count )
+{
+  Metric test( "test" );
+  ASSERT_EQ( 0, test.get() );
+  ASSERT_EQ( Metric::Kind::Counter, test.getKind() );
+
+  test.increment();
+  test.increment( 10 );
+  ASSERT_EQ( 11, test.get() );
+}
+
+TEST( metric_should, hold_a_level )
+{
+  Metric test( "test", Metric::Kind::Gauge );
+
+  test.set( 100 );
+  test.set( 25 );
+  ASSERT_EQ( 25, test.get() );
+}
+
+TEST( metric_should, register_in_order )
+{
+  auto first = std::make_unique<Metric>( "first" );
+  {
+    Metric second( "second" );
+    ASSERT_TRUE( isRegistered( *first ));
+    ASSERT_TRUE( isRegistered( second ));
+    ASSERT_EQ( &second, first->next() );
+  }
+  // second unregistered itself on the way out
+  ASSERT_EQ( nullptr, first->next() );
+}
+
+} // end namespace Util
@@ -6,7 +6,7 @@
 #define __TEST_MOCK_NET_H__
 
 #include <algorithm>
-#include "../firmware_v1/net_interface.h"
+#include "../firmware_v2/net_interface.h"
 #include "test_mock_event.h"
 #include "test_mock_hardware.h"
 
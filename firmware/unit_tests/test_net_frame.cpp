@@ -0,0 +1,212 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../firmware_v2/command_parser.h"
+#include "../firmware_v2/net_frame.h"
+#include "test_mock_net.h"
+
+namespace NetFrame {
+
+namespace {
+
+std::vector< uint8_t > makeFrame( Type type, const std::vector< uint8_t >& payload )
+{
+  Buffer frame;
+  const size_t length = encode( type, payload.data(), payload.size(), frame.data() );
+  return std::vector< uint8_t >( frame.begin(), frame.begin() + length );
+}
+
+void send( NetConnection& connection, const std::vector< uint8_t >& bytes )
+{
+  connection.readBuffer.write( reinterpret_cast<const char*>( bytes.data() ), bytes.size() );
+}
+
+std::vector< uint8_t > drain( NetPipe& pipe )
+{
+  std::vector< uint8_t > out;
+  while ( pipe.available() != 0 ) {
+    out.push_back( static_cast<uint8_t>( pipe.getChar() ));
+  }
+  return out;
+}
+
+} // end anonymous namespace
+
+TEST( net_frame_should, round_trip_through_the_decoder )
+{
+  const std::vector< uint8_t > payload = { 0, '\n', 0xA5, 0xff, 7 };
+  const std::vector< uint8_t > frame = makeFrame( Type::Command, payload );
+  ASSERT_EQ( payload.size() + overhead, frame.size() );
+  ASSERT_EQ( sync, frame[ 0 ] );
+
+  Decoder decoder;
+  for ( size_t i = 0; i + 1 < frame.size(); ++i ) {
+    ASSERT_FALSE( decoder.push( frame[ i ] ));
+  }
+  ASSERT_TRUE( decoder.push( frame.back() ));
+  ASSERT_EQ( Type::Command, decoder.type() );
+  ASSERT_EQ( payload, std::vector< uint8_t >( decoder.payload(), decoder.payload() + decoder.length() ));
+}
+
+TEST( net_frame_should, skip_garbage_and_bad_checksums )
+{
+  const std::vector< uint8_t > good = makeFrame( Type::Command, { 3 } );
+  std::vector< uint8_t > bad = good;
+  bad[ 3 ] ^= 1;
+
+  std::vector< uint8_t > stream = { 'x', 'y' };
+  stream.insert( stream.end(), bad.begin(), bad.end() );
+  stream.insert( stream.end(), good.begin(), good.end() );
+
+  Decoder decoder;
+  unsigned int frames = 0;
+  for ( uint8_t byte : stream ) {
+    if ( decoder.push( byte )) {
+      ++frames;
+      ASSERT_EQ( 3, decoder.payload()[ 0 ] );
+    }
+  }
+  ASSERT_EQ( 1, frames );
+  ASSERT_EQ( 1, decoder.badFrames() );
+}
+
+TEST( net_frame_should, pack_telemetry_little_endian )
+{
+  const TelemetryRecord record = TelemetryRecord::fromSample( -100000, 40000, 258, -3, 500, -90 );
+  uint8_t frame[ TelemetryRecord::frameSize ];
+  record.encodeFrame( frame );
+
+  ASSERT_EQ( static_cast<uint8_t>( Type::Telemetry ), frame[ 1 ] );
+  ASSERT_EQ( TelemetryRecord::size, frame[ 2 ] );
+  // encoderRPosition = 258 = 0x102, little endian at payload offset 6
+  ASSERT_EQ( 0x02, frame[ headerSize + 6 ] );
+  ASSERT_EQ( 0x01, frame[ headerSize + 7 ] );
+
+  const TelemetryRecord back = TelemetryRecord::decode( frame + headerSize );
+  ASSERT_EQ( -100000, back.encoderLPosition );
+  ASSERT_EQ( 32767, back.encoderLSpeed );       // clamped
+  ASSERT_EQ( 258, back.encoderRPosition );
+  ASSERT_EQ( -3, back.encoderRSpeed );
+  ASSERT_EQ( 500, back.range );
+  ASSERT_EQ( -90, back.gyroAngle );
+}
+
+TEST( net_frame_should, pack_a_self_contained_datagram )
+{
+  TelemetryDatagram datagram{ 0x01020304, 123456789, TelemetryRecord::fromSample( 1, 2, 3, 4, 5, 6 ) };
+  uint8_t frame[ TelemetryDatagram::frameSize ];
+  datagram.encodeFrame( frame );
+
+  Decoder decoder;
+  bool good = false;
+  for ( uint8_t byte : frame ) {
+    good = decoder.push( byte );
+  }
+  ASSERT_TRUE( good );
+  ASSERT_EQ( Type::TelemetryDatagram, decoder.type() );
+  const TelemetryDatagram back = TelemetryDatagram::decode( decoder.payload() );
+  ASSERT_EQ( 0x01020304u, back.sequence );
+  ASSERT_EQ( 123456789u, back.deviceTimeUs );
+  ASSERT_EQ( 3, back.record.encoderRPosition );
+  ASSERT_EQ( 6, back.record.gyroAngle );
+}
+
+TEST( net_frame_should, parse_binary_commands_and_frame_responses )
+{
+  NetMockSimpleConnection connection;
+  connection.setProtocol( Protocol::Binary );
+
+  // motorl -50, then a ping
+  std::vector< uint8_t > motor = { static_cast<uint8_t>( CommandParser::Command::SetMotorL ), 0, 0, 0, 0 };
+  putLE32( motor.data() + 1, static_cast<uint32_t>( -50 ));
+  send( connection, makeFrame( Type::Command, motor ));
+  send( connection, makeFrame( Type::Command, { static_cast<uint8_t>( CommandParser::Command::Ping ) } ));
+
+  ASSERT_EQ( CommandParser::CommandPacket( CommandParser::Command::SetMotorL, -50 ),
+             CommandParser::checkForCommands( connection ));
+  ASSERT_EQ( CommandParser::CommandPacket( CommandParser::Command::Ping ),
+             CommandParser::checkForCommands( connection ));
+  ASSERT_EQ( CommandParser::CommandPacket(), CommandParser::checkForCommands( connection ));
+
+  // A command that needs an argument gets 0 without one, like ASCII
+  send( connection, makeFrame( Type::Command, { static_cast<uint8_t>( CommandParser::Command::DataSend ) } ));
+  ASSERT_EQ( CommandParser::CommandPacket( CommandParser::Command::DataSend, 0 ),
+             CommandParser::checkForCommands( connection ));
+
+  // A tag goes after the argument
+  std::vector< uint8_t > tagged = { static_cast<uint8_t>( CommandParser::Command::Ping ), 0, 0, 0, 0, 0, 0, 0, 0 };
+  putLE32( tagged.data() + 1, 1000 );
+  putLE32( tagged.data() + 5, 77 );
+  send( connection, makeFrame( Type::Command, tagged ));
+  ASSERT_EQ( CommandParser::CommandPacket( CommandParser::Command::Ping, 1000, 77 ),
+             CommandParser::checkForCommands( connection ));
+
+  // Text goes out a line per frame
+  connection << "PONG\n";
+  const std::vector< uint8_t > golden = makeFrame( Type::Text, { 'P', 'O', 'N', 'G' } );
+  ASSERT_EQ( golden, drain( connection.writeBuffer ));
+}
+
+TEST( net_frame_should, drop_whole_telemetry_frames )
+{
+  NetMockSimpleConnection connection;
+  connection.setProtocol( Protocol::Binary );
+
+  // 511 bytes holds 24 frames of 21
+  uint8_t frame[ TelemetryRecord::frameSize ];
+  for ( int i = 0; i < 30; ++i ) {
+    TelemetryRecord::fromSample( i, 0, 0, 0, 0, 0 ).encodeFrame( frame );
+    connection.telemetry().writeFrame( frame, sizeof( frame ));
+  }
+
+  ASSERT_EQ( 24 * sizeof( frame ), connection.pumpTelemetry( 1023 ));
+  const std::vector< uint8_t > sent = drain( connection.writeBuffer );
+  const TelemetryRecord oldest = TelemetryRecord::decode( sent.data() + headerSize );
+  ASSERT_EQ( 6, oldest.encoderLPosition );
+}
+
+//
+// Not a correctness test - compares formatting DataSend's four ASCII lines
+// to packing one telemetry frame, and reports bytes and time per sample.
+//
+TEST( net_frame_should, benchmark_ascii_vs_binary_telemetry )
+{
+  constexpr unsigned int numSamples = 100000;
+  NetMockSimpleConnection connection;
+
+  auto timeIt = [&]( auto body ) {
+    size_t bytes = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for ( unsigned int i = 0; i < numSamples; ++i ) {
+      body( static_cast<int>( i ));
+      bytes += connection.telemetryBuffer.available();
+      connection.telemetryBuffer.readAdvance( connection.telemetryBuffer.available() );
+    }
+    const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return std::make_pair( bytes / numSamples, elapsed.count() / numSamples );
+  };
+
+  const auto ascii = timeIt( [&]( int i ) {
+    NetTelemetry& telemetry = connection.telemetry();
+    telemetry << "ENL " << 100000 + i << " " << -1234 << "\n";
+    telemetry << "ENR " << 100000 - i << " " << 1234 << "\n";
+    telemetry << "RNG " << 480 << "\n";
+    telemetry << "GYR " << -90 << "\n";
+  });
+
+  const auto binary = timeIt( [&]( int i ) {
+    uint8_t frame[ TelemetryRecord::frameSize ];
+    TelemetryRecord::fromSample( 100000 + i, -1234, 100000 - i, 1234, 480, -90 ).encodeFrame( frame );
+    connection.telemetry().writeFrame( frame, sizeof( frame ));
+  });
+
+  std::cout << "ASCII  telemetry: " << ascii.first << " bytes, " << ascii.second << " ns per sample\n";
+  std::cout << "Binary telemetry: " << binary.first << " bytes, " << binary.second << " ns per sample\n";
+  ASSERT_LT( binary.first, ascii.first );
+}
+
+} // end namespace NetFrame
@@ -0,0 +1,88 @@
+#include <gtest/gtest.h>
+
+#include "../firmware_v2/net_poll.h"
+
+TEST( net_poll_should, back_off_when_idle_and_snap_back_on_traffic )
+{
+  NetPoll poll;
+  ASSERT_EQ( Time::TimeUS( 250 ), poll.next( true, false ));
+
+  // Idle polls double, up to the maximum
+  ASSERT_EQ( Time::TimeUS( 500 ), poll.next( false, false ));
+  ASSERT_EQ( Time::TimeUS( 1000 ), poll.next( false, false ));
+  for ( int i = 0; i < 10; ++i ) {
+    poll.next( false, false );
+  }
+  ASSERT_EQ( Time::TimeUS( 20000 ), poll.next( false, false ));
+
+  // Traffic, or bytes waiting to go out, go straight back to the minimum
+  ASSERT_EQ( Time::TimeUS( 250 ), poll.next( true, false ));
+  poll.next( false, false );
+  ASSERT_EQ( Time::TimeUS( 250 ), poll.next( false, true ));
+}
+
+TEST( net_poll_should, send_small_writes_once_they_stop_growing )
+{
+  NetPoll poll;
+  ASSERT_FALSE( poll.readyToSend( 0 ));
+
+  // A big write goes right away
+  ASSERT_TRUE( poll.readyToSend( 128 ));
+
+  // A lone response waits one poll
+  ASSERT_FALSE( poll.readyToSend( 5 ));
+  poll.next( false, true );
+  ASSERT_TRUE( poll.readyToSend( 5 ));
+
+  // unless it grows past coalesceBytes first
+  ASSERT_FALSE( poll.readyToSend( 5 ));
+  poll.next( false, true );
+  ASSERT_TRUE( poll.readyToSend( 200 ));
+}
+
+TEST( net_poll_should, hold_growing_writes_for_at_most_the_window )
+{
+  NetPoll poll;
+
+  // Output that keeps trickling in waits out the 1000us window, polling
+  // at 250us
+  unsigned int polls = 0;
+  while ( !poll.readyToSend( 5 + polls )) {
+    ASSERT_EQ( Time::TimeUS( 250 ), poll.next( false, true ));
+    ++polls;
+  }
+  ASSERT_EQ( 4, polls );
+}
+
+TEST( net_poll_should, not_back_off_past_the_window_while_holding )
+{
+  NetPoll::Options options;
+  options.minInterval = Time::TimeUS( 5000 );
+  NetPoll poll( options );
+
+  ASSERT_FALSE( poll.readyToSend( 1 ));
+  ASSERT_EQ( Time::TimeUS( 1000 ), poll.next( false, true ));
+  ASSERT_TRUE( poll.readyToSend( 1 ));
+}
+
+TEST( net_poll_should, start_each_hold_with_a_full_window )
+{
+  NetPoll poll;
+
+  // Hold growing output for two polls, then the pipe drains some other
+  // way (i.e., a push because it filled up)
+  ASSERT_FALSE( poll.readyToSend( 5 ));
+  poll.next( false, true );
+  ASSERT_FALSE( poll.readyToSend( 6 ));
+  poll.next( false, true );
+  ASSERT_FALSE( poll.readyToSend( 0 ));
+  poll.next( true, false );
+
+  // The next hold gets the whole 1000us again
+  unsigned int polls = 0;
+  while ( !poll.readyToSend( 5 + polls )) {
+    poll.next( false, true );
+    ++polls;
+  }
+  ASSERT_EQ( 4, polls );
+}
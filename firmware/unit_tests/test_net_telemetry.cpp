@@ -0,0 +1,165 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "test_mock_net.h"
+
+namespace {
+
+std::string drain( NetPipe& pipe )
+{
+  std::string out;
+  while ( char c = pipe.getChar() ) {
+    out.push_back( c );
+  }
+  return out;
+}
+
+// Records datagrams instead of sending them
+class DatagramConnection: public NetMockSimpleConnection
+{
+  public:
+
+  bool openDatagramImpl( uint16_t ) override { return true; }
+  bool sendDatagramImpl( const uint8_t* data, size_t length ) override {
+    datagrams.emplace_back( data, data + length );
+    return true;
+  }
+
+  std::vector< std::vector< uint8_t >> datagrams;
+};
+
+// A client that stops reading for one push, after it's taken stallAfter
+// characters, and then carries on if it's still connected
+class StallingConnection: public NetMockSimpleConnection
+{
+  public:
+
+  void writePushImpl( NetPipe& pipe ) override {
+    if ( !connected || ( wire.size() >= stallAfter && !stalled )) {
+      stalled = true;
+      return;
+    }
+    while ( pipe.available() != 0 ) {
+      wire.push_back( pipe.getChar() );
+    }
+  }
+  operator bool( void ) override { return connected; }
+  void reset( void ) override { connected = false; }
+
+  size_t stallAfter = 0;
+  bool stalled = false;
+  bool connected = true;
+  std::string wire;
+};
+
+} // end anonymous namespace
+
+TEST( net_telemetry_should, only_move_whole_lines_that_can_be_sent )
+{
+  NetMockSimpleConnection connection;
+  connection << "PONG\n";
+  connection.telemetry() << "ENL " << 12 << " " << 34 << "\n";
+  connection.telemetry() << "GYR " << 50;
+
+  // The response stays first, and the half written GYR line stays put
+  ASSERT_EQ( 10, connection.pumpTelemetry( 100 ));
+  ASSERT_EQ( "PONG\nENL 12 34\n", drain( connection.writeBuffer ));
+
+  // Nothing moves until the whole line fits in the budget
+  connection.telemetry() << "\n";
+  ASSERT_EQ( 0, connection.pumpTelemetry( 3 ));
+  ASSERT_EQ( 7, connection.pumpTelemetry( 7 ));
+  ASSERT_EQ( "GYR 50\n", drain( connection.writeBuffer ));
+}
+
+TEST( net_telemetry_should, drop_the_oldest_whole_lines_when_full )
+{
+  NetMockSimpleConnection connection;
+
+  // 40 lines of 20 characters won't fit in the telemetry pipe
+  for ( int i = 0; i < 40; ++i ) {
+    connection.telemetry() << "ENL " << 1000 + i << " 0123456789\n";
+  }
+
+  // Everything left is whole lines, ending with the newest
+  ASSERT_NE( 0, connection.pumpTelemetry( 1023 ));
+  const std::string sent = drain( connection.writeBuffer );
+  ASSERT_EQ( 0, sent.size() % 20 );
+  ASSERT_EQ( "ENL 1039 0123456789\n", sent.substr( sent.size() - 20 ));
+  ASSERT_NE( "ENL 1000 0123456789\n", sent.substr( 0, 20 ));
+  for ( size_t line = 0; line < sent.size(); line += 20 ) {
+    ASSERT_EQ( "ENL 10", sent.substr( line, 6 ));
+    ASSERT_EQ( '\n', sent[ line + 19 ] );
+  }
+}
+
+TEST( net_telemetry_should, fill_what_the_window_leaves_after_responses )
+{
+  NetMockSimpleConnection connection;
+
+  // 400 characters of responses are already waiting
+  const std::string response( 399, 'r' );
+  connection << response.c_str() << "\n";
+  for ( int i = 0; i < 25; ++i ) {
+    connection.telemetry() << "ENL " << 1000 + i << " 0123456789\n";
+  }
+
+  // A 700 character window has room for 300 characters of telemetry
+  ASSERT_EQ( 300, connection.pumpTelemetry( 700 ));
+  ASSERT_EQ( 700, connection.writeBuffer.available() );
+}
+
+TEST( net_telemetry_should, hang_up_on_a_stalled_client_instead_of_cutting_lines )
+{
+  StallingConnection connection;
+  connection.stallAfter = 1500;
+  std::string expected;
+  for ( int i = 0; i < 300; ++i ) {
+    const std::string line = "response " + std::to_string( 1000 + i ) + "\n";
+    expected += line;
+    connection << line.c_str();
+  }
+
+  // The client got the start of the stream, with nothing cut out of the
+  // middle, and then it was hung up on
+  ASSERT_TRUE( connection.stalled );
+  ASSERT_FALSE( connection );
+  ASSERT_LT( 0u, connection.wire.size() );
+  ASSERT_EQ( expected.substr( 0, connection.wire.size() ), connection.wire );
+}
+
+TEST( net_telemetry_should, send_each_datagram_whole )
+{
+  NetMockSimpleConnection noUdp;
+  ASSERT_FALSE( noUdp.setTelemetryPort( 5000 ));
+  ASSERT_FALSE( noUdp.sendsTelemetryDatagrams() );
+
+  DatagramConnection connection;
+  ASSERT_TRUE( connection.setTelemetryPort( 5000 ));
+  ASSERT_TRUE( connection.sendsTelemetryDatagrams() );
+
+  uint8_t frame[ NetFrame::TelemetryDatagram::frameSize ];
+  for ( unsigned int i = 0; i < 3; ++i ) {
+    NetFrame::TelemetryDatagram datagram{ i, 1000 * i, 
+      NetFrame::TelemetryRecord::fromSample( 1, 2, 3, 4, 5, 6 ) };
+    datagram.encodeFrame( frame );
+    connection.sendTelemetryDatagram( frame, sizeof( frame ));
+  }
+
+  // One whole frame per datagram, in order, and nothing in the stream
+  ASSERT_EQ( 3, connection.datagrams.size() );
+  for ( unsigned int i = 0; i < 3; ++i ) {
+    ASSERT_EQ( NetFrame::TelemetryDatagram::frameSize, connection.datagrams[ i ].size() );
+    const auto datagram = NetFrame::TelemetryDatagram::decode( 
+      connection.datagrams[ i ].data() + NetFrame::headerSize );
+    ASSERT_EQ( i, datagram.sequence );
+    ASSERT_EQ( 1000 * i, datagram.deviceTimeUs );
+  }
+  ASSERT_EQ( 0, connection.writeBuffer.available() );
+  ASSERT_EQ( 0, connection.telemetryBuffer.available() );
+
+  ASSERT_TRUE( connection.setTelemetryPort( 0 ));
+  ASSERT_FALSE( connection.sendsTelemetryDatagrams() );
+}
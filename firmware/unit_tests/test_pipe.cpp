@@ -1,6 +1,10 @@
 #include <gtest/gtest.h>
 
-#include "../firmware_v1/util_pipe.h"
+#include <chrono>
+#include <iostream>
+#include <string>
+
+#include "../firmware_v2/util_pipe.h"
 
 namespace Util {
 
@@ -8,9 +12,9 @@ TEST( pipe_should, add_and_remove_single_characters )
 {
   // using MyPipe = Pipe< char, 255 >;   Static Asserts, size != power of 2
   // using MyPipe = Pipe< char, 0 >;     Static Asserts, size has to be >0
-  using MyPipe = Pipe< char, 64 >;
-  unsigned pushCount=0;
-  MyPipe pipe( [&pushCount]( MyPipe& pipe ) { pipe.getChar(); ++pushCount; });
+  using MyPipe = Pipe< char, 64, PipeOverflow::DropOldest >;
+  Metric pushCount( "test" );
+  MyPipe pipe( PipeOverflow::DropOldest{ &pushCount } );
 
   ASSERT_EQ( 0, pipe.getChar() );
 
@@ -20,13 +24,13 @@ TEST( pipe_should, add_and_remove_single_characters )
   for ( char golden = 0; golden < 32; ++golden ) {
     ASSERT_EQ( golden, pipe.getChar() );
   }
-  ASSERT_EQ( 0, pushCount );
+  ASSERT_EQ( 0, pushCount.get() );
   ASSERT_EQ( 0, pipe.getChar() );
   for ( char i= 0; i< 64; ++i) {
     pipe.putChar( i );
   }
   // Should have overflowed the pipe once
-  ASSERT_EQ( 1, pushCount );
+  ASSERT_EQ( 1, pushCount.get() );
   for ( char golden = 1; golden < 64; ++golden ) {
     ASSERT_EQ( golden, pipe.getChar() );
   }
@@ -34,8 +38,8 @@ TEST( pipe_should, add_and_remove_single_characters )
 
 TEST( pipe_should, do_read_buffers)
 {
-  using MyPipe = Pipe< char, 64 >;
-  MyPipe pipe( []( MyPipe& pipe ) { assert(0); } );
+  using MyPipe = Pipe< char, 64, PipeOverflow::Fail >;
+  MyPipe pipe;
 
   // Empty test
   MyPipe::Buffer rb0 = pipe.readView( 64 );
@@ -90,9 +94,9 @@ TEST( pipe_should, do_read_buffers)
 
 TEST( pipe_should, do_write_buffers)
 {
-  using MyPipe = Pipe< char, 64 >;
-  unsigned pushCount=0;
-  MyPipe pipe( [&pushCount]( MyPipe& pipe ) { pipe.getChar(); ++pushCount; });
+  using MyPipe = Pipe< char, 64, PipeOverflow::DropOldest >;
+  Metric pushCount( "test" );
+  MyPipe pipe( PipeOverflow::DropOldest{ &pushCount } );
 
   // Request more than what's in the buffer, but don't advance
   MyPipe::Buffer rb0 = pipe.writeView( 96 );
@@ -126,15 +130,15 @@ TEST( pipe_should, do_write_buffers)
   pipe.writeAdvance( 30 ); // only put in 30 characters, one short.
 
   // Should have no push events
-  ASSERT_EQ( 0, pushCount );
+  ASSERT_EQ( 0, pushCount.get() );
 
   // We can add one more byte, and the buffer is full
   pipe.putChar( 30+32 ); 
-  ASSERT_EQ( 0, pushCount );
+  ASSERT_EQ( 0, pushCount.get() );
 
   // Adding another byte to a full buffer should push
   pipe.putChar( 31+32 ); 
-  ASSERT_EQ( 1, pushCount );
+  ASSERT_EQ( 1, pushCount.get() );
 
   // Check results
   for ( char golden = 1; golden < 64; ++golden ) {
@@ -142,5 +146,175 @@ TEST( pipe_should, do_write_buffers)
   }
 }
 
+TEST( pipe_should, do_block_writes_and_reads )
+{
+  using MyPipe = Pipe< char, 64 >;
+  MyPipe pipe;
+  ASSERT_EQ( 0, pipe.available() );
+  ASSERT_EQ( 63, pipe.space() );
+
+  // Move the indexes near the end so the next write wraps
+  char scratch[ 64 ];
+  ASSERT_EQ( 50, pipe.write( "01234567890123456789012345678901234567890123456789", 50 ));
+  ASSERT_EQ( 50, pipe.read( scratch, 64 ));
+  ASSERT_EQ( 0, pipe.available() );
+
+  // Wrapped write
+  const std::string alphabet = "abcdefghijklmnopqrstuvwxyz";
+  ASSERT_EQ( 26, pipe.write( alphabet.c_str(), 26 ));
+  ASSERT_EQ( 26, pipe.available() );
+
+  // Partial write - only 37 more fit
+  const std::string big( 50, 'x' );
+  ASSERT_EQ( 37, pipe.write( big.c_str(), big.size() ));
+  ASSERT_EQ( 0, pipe.space() );
+  ASSERT_EQ( 0, pipe.write( "y", 1 ));
+
+  // Wrapped read, in two parts
+  ASSERT_EQ( 10, pipe.read( scratch, 10 ));
+  ASSERT_EQ( "abcdefghij", std::string( scratch, 10 ));
+  ASSERT_EQ( 53, pipe.read( scratch, 64 ));
+  ASSERT_EQ( "klmnopqrstuvwxyz", std::string( scratch, 16 ));
+  ASSERT_EQ( std::string( 37, 'x' ), std::string( scratch + 16, 37 ));
+  ASSERT_EQ( 0, pipe.read( scratch, 64 ));
+}
+
+TEST( pipe_should, do_wrapped_views )
+{
+  using MyPipe = Pipe< char, 64 >;
+  MyPipe pipe;
+
+  // Empty
+  MyPipe::Buffers empty = pipe.readViews( 64 );
+  ASSERT_EQ( 0, empty[ 0 ].second );
+  ASSERT_EQ( 0, empty[ 1 ].second );
+
+  // Move the indexes to 50, then write 30 characters with writeViews so
+  // they wrap.
+  char scratch[ 64 ];
+  ASSERT_EQ( 50, pipe.write( std::string( 50, '-' ).c_str(), 50 ));
+  ASSERT_EQ( 50, pipe.read( scratch, 64 ));
+
+  MyPipe::Buffers out = pipe.writeViews( 30 );
+  ASSERT_EQ( 14, out[ 0 ].second );
+  ASSERT_EQ( 16, out[ 1 ].second );
+  char next = 'A';
+  for ( const MyPipe::Buffer& buffer : out ) {
+    for ( size_t i = 0; i < buffer.second; ++i ) {
+      buffer.first[ i ] = next++;
+    }
+  }
+  pipe.writeAdvance( 30 );
+
+  // All of it back in one readViews
+  MyPipe::Buffers in = pipe.readViews( 64 );
+  ASSERT_EQ( 14, in[ 0 ].second );
+  ASSERT_EQ( 16, in[ 1 ].second );
+  const std::string all = std::string( in[ 0 ].first, in[ 0 ].second ) + 
+                          std::string( in[ 1 ].first, in[ 1 ].second );
+  ASSERT_EQ( "ABCDEFGHIJKLMNOPQRSTUVWXYZ[\\]^", all );
+
+  // A short request only uses the first buffer
+  MyPipe::Buffers part = pipe.readViews( 10 );
+  ASSERT_EQ( 10, part[ 0 ].second );
+  ASSERT_EQ( nullptr, part[ 1 ].first );
+  ASSERT_EQ( 0, part[ 1 ].second );
+
+  pipe.readAdvance( 30 );
+  ASSERT_EQ( 0, pipe.available() );
+
+  // Free space wraps too - 63 total, from 16 to the end then the start
+  MyPipe::Buffers space = pipe.writeViews( 100 );
+  ASSERT_EQ( 48, space[ 0 ].second );
+  ASSERT_EQ( 15, space[ 1 ].second );
+}
+
+TEST( pipe_should, apply_overflow_policies )
+{
+  // Drop newest keeps what's there and refuses the new character
+  using NewestPipe = Pipe< char, 4, PipeOverflow::DropNewest >;
+  Metric drops( "drops" );
+  NewestPipe newest( PipeOverflow::DropNewest{ &drops } );
+  ASSERT_TRUE( newest.putChar( 'a' ));
+  ASSERT_TRUE( newest.putChar( 'b' ));
+  ASSERT_TRUE( newest.putChar( 'c' ));
+  ASSERT_FALSE( newest.putChar( 'd' ));
+  ASSERT_EQ( 1, drops.get() );
+  ASSERT_EQ( 'a', newest.getChar() );
+  ASSERT_EQ( 'b', newest.getChar() );
+  ASSERT_EQ( 'c', newest.getChar() );
+  ASSERT_EQ( 0, newest.getChar() );
+
+  // Drop oldest line throws away whole lines, and counts lines
+  using LinePipe = Pipe< char, 16, PipeOverflow::DropOldestLine >;
+  Metric lineDrops( "line drops" );
+  LinePipe lines( PipeOverflow::DropOldestLine{ &lineDrops } );
+  for ( char c : std::string( "aaa\nbbbb\ncc\ndddd\n" )) {
+    ASSERT_TRUE( lines.putChar( c ));
+  }
+  ASSERT_EQ( 1, lineDrops.get() );
+  char scratch[ 16 ];
+  const size_t length = lines.read( scratch, sizeof( scratch ));
+  ASSERT_EQ( "bbbb\ncc\ndddd\n", std::string( scratch, length ));
+
+  // Block flush hands the full pipe to its owner
+  struct Owner {
+    std::string flushed;
+    void flush( Pipe< char, 4, PipeOverflow::BlockFlush< Owner >>& pipe ) {
+      while ( char c = pipe.getChar() ) { flushed.push_back( c ); }
+    }
+  };
+  Owner owner;
+  Pipe< char, 4, PipeOverflow::BlockFlush< Owner >> flushing( PipeOverflow::BlockFlush< Owner >{ &owner } );
+  for ( char c : std::string( "abcdef" )) {
+    ASSERT_TRUE( flushing.putChar( c ));
+  }
+  ASSERT_EQ( "abc", owner.flushed );
+  ASSERT_EQ( 'd', flushing.getChar() );
+}
+
+//
+// Not a correctness test - compares putChar/getChar to block write/read
+// on telemetry sized lines and reports the time per byte.
+//
+TEST( pipe_should, benchmark_block_vs_char_access )
+{
+  using MyPipe = Pipe< char, 1024, PipeOverflow::DropOldest >;
+  MyPipe pipe;
+
+  const std::string line = "ENL 1234567 -4031 8843 -2 17 10230 99 1 0 0 0 28\n";
+  constexpr unsigned int numLines = 200000;
+  char scratch[ 1024 ];
+
+  auto timeIt = [&]( auto body ) {
+    const auto start = std::chrono::steady_clock::now();
+    for ( unsigned int i = 0; i < numLines; ++i ) {
+      body();
+    }
+    const auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>( end - start ).count() / ( numLines * line.size() );
+  };
+
+  size_t charBytes = 0;
+  const double perChar = timeIt( [&]() {
+    for ( char c : line ) {
+      pipe.putChar( c );
+    }
+    while ( pipe.getChar() ) {
+      ++charBytes;
+    }
+  });
+
+  size_t blockBytes = 0;
+  const double perBlock = timeIt( [&]() {
+    pipe.write( line.c_str(), line.size() );
+    blockBytes += pipe.read( scratch, sizeof( scratch ));
+  });
+
+  ASSERT_EQ( charBytes, blockBytes );
+  std::cout << "putChar/getChar: " << perChar << " ns/byte, "
+            << "write/read: " << perBlock << " ns/byte\n";
+}
+
 } // end namespace Util
 
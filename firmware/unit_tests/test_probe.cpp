@@ -0,0 +1,94 @@
+#include <gtest/gtest.h>
+
+#include "../firmware_v2/util_probe.h"
+
+namespace Util {
+
+namespace {
+
+class ManualHST: public Time::HST
+{
+  public:
+
+  Time::DeviceTimeMS msSinceDeviceStart() override { return Time::DeviceTimeMS( now / 1000 ); }
+  Time::DeviceTimeUS usSinceDeviceStart() override { return Time::DeviceTimeUS( now ); }
+  Time::TimeUS execute() override { return Time::TimeUS( 0 ); }
+  const char* debugName() override { return "ManualHST"; }
+
+  unsigned long long now = 0;
+};
+
+#ifndef OCTO_NO_PROBES
+void probedFunction( ManualHST& hst, unsigned int cost )
+{
+  OCTO_PROBE_SCOPE( "Probed Function" );
+  hst.now += cost;
+}
+#endif
+
+bool isRegistered( const Probe& target )
+{
+  for ( Probe* probe = Probe::first(); probe != nullptr; probe = probe->next() ) {
+    if ( probe == &target ) {
+      return true;
+    }
+  }
+  return false;
+}
+
+} // end anonymous namespace
+
+TEST( probe_should, register_itself )
+{
+  Probe test( "test" );
+  ASSERT_TRUE( isRegistered( test ));
+}
+
+// Timing is compiled out with OCTO_NO_PROBES.  Probes still register, so
+// the reports keep working.
+#ifndef OCTO_NO_PROBES
+TEST( probe_should, time_a_scope )
+{
+  auto hst = std::make_shared<ManualHST>();
+  Probe test( "test" );
+
+  // No clock, no sample
+  {
+    ScopedTimer timer( test );
+  }
+  ASSERT_EQ( 0, test.getProfile().numSamples() );
+
+  Probe::setClock( hst );
+  {
+    ScopedTimer timer( test );
+    hst->now += 250;
+  }
+  ASSERT_EQ( 1, test.getProfile().numSamples() );
+  ASSERT_EQ( 250, test.getProfile().maxSample().get() );
+
+  Probe::resetAll();
+  ASSERT_EQ( 0, test.getProfile().numSamples() );
+  Probe::setClock( nullptr );
+}
+
+TEST( probe_should, share_one_probe_per_scope )
+{
+  auto hst = std::make_shared<ManualHST>();
+  Probe::setClock( hst );
+
+  probedFunction( *hst, 10 );
+  probedFunction( *hst, 30 );
+
+  // Find the function's probe by its samples
+  const Probe* found = nullptr;
+  for ( Probe* probe = Probe::first(); probe != nullptr; probe = probe->next() ) {
+    if ( probe->getProfile().numSamples() == 2 && probe->getProfile().maxSample().get() == 30 ) {
+      found = probe;
+    }
+  }
+  ASSERT_NE( nullptr, found );
+  Probe::setClock( nullptr );
+}
+#endif
+
+} // end namespace Util
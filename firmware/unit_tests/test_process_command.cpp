@@ -0,0 +1,192 @@
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <string>
+
+#include "../firmware_v2/command_process_input.h"
+#include "test_mock_debug.h"
+#include "test_mock_net.h"
+
+namespace Command {
+
+namespace {
+
+class ManualHST: public Time::HST
+{
+  public:
+
+  Time::DeviceTimeMS msSinceDeviceStart() override { return Time::DeviceTimeMS( now / 1000 ); }
+  Time::DeviceTimeUS usSinceDeviceStart() override { return Time::DeviceTimeUS( now ); }
+  Time::TimeUS execute() override { return Time::TimeUS( 0 ); }
+  const char* debugName() override { return "ManualHST"; }
+
+  unsigned long long now = 0;
+};
+
+// A connection that's handed its input the way the backends read it
+class ReadingConnection: public NetMockSimpleConnection
+{
+  public:
+
+  void receive( const std::string& text )
+  {
+    readBuffer.write( text.data(), text.size() );
+    dataReceived( text.data(), text.size() );
+  }
+};
+
+// One client, always connected
+class OneClientNet: public NetInterface
+{
+  public:
+
+  NetConnection& get() override { return *connection; }
+  std::shared_ptr<NetConnection> getShared() override { return connection; }
+  Time::TimeUS execute() override { return Time::TimeUS( 0 ); }
+  const char* debugName() override { return "OneClientNet"; }
+
+  std::shared_ptr<ReadingConnection> connection = std::make_shared<ReadingConnection>();
+};
+
+// A ProcessCommand with only the parts the tests use
+class ProcessCommandTest: public ::testing::Test
+{
+  protected:
+
+  ProcessCommandTest() :
+    net{ std::make_shared<OneClientNet>() },
+    hst{ std::make_shared<ManualHST>() },
+    process{ net, nullptr, std::make_shared<DebugInterfaceIgnoreMock>(), nullptr,
+             nullptr, nullptr, nullptr, nullptr, nullptr, nullptr,
+             hst, nullptr, nullptr }
+  {
+    NetConnection::setArrivalClock( hst );
+    output();
+  }
+
+  ~ProcessCommandTest()
+  {
+    NetConnection::setArrivalClock( nullptr );
+  }
+
+  void send( const std::string& text )
+  {
+    net->connection->receive( text );
+  }
+
+  // Everything the client was sent since the last call
+  std::string output()
+  {
+    std::string out;
+    NetPipe& pipe = net->connection->writeBuffer;
+    while ( pipe.available() != 0 ) {
+      out += pipe.getChar();
+    }
+    return out;
+  }
+
+  static unsigned int count( const std::string& text, const std::string& what )
+  {
+    unsigned int found = 0;
+    for ( size_t at = text.find( what ); at != std::string::npos; at = text.find( what, at + 1 )) {
+      ++found;
+    }
+    return found;
+  }
+
+  std::shared_ptr<OneClientNet> net;
+  std::shared_ptr<ManualHST> hst;
+  ProcessCommand process;
+};
+
+} // end anonymous namespace
+
+TEST_F( ProcessCommandTest, keep_going_after_a_bad_line )
+{
+  send( "timeus\nbogus\ntimeus\n" );
+
+  // All three in one slice, then the backstop because nothing's left
+  ASSERT_EQ( Time::TimeUS( Time::TimeMS( 100 )), process.execute() );
+  const std::string out = output();
+  ASSERT_EQ( 2, count( out, "ustimer " ));
+  ASSERT_EQ( 1, count( out, "# Unknown command\n" ));
+}
+
+TEST_F( ProcessCommandTest, skip_blank_lines )
+{
+  send( "\n;\ntimeus;;timeus\n" );
+  process.execute();
+  const std::string out = output();
+  ASSERT_EQ( 2, count( out, "ustimer " ));
+  ASSERT_EQ( 0, count( out, "# Unknown command\n" ));
+}
+
+TEST_F( ProcessCommandTest, stop_at_the_budget_but_finish_the_batch )
+{
+  process.setCommandBudget( 2 );
+  send( "timeus;bogus;timeus\ntimeus\ntimeus\n" );
+
+  // The batch and one more line, then straight back for the rest
+  ASSERT_EQ( Time::TimeUS( 0 ), process.execute() );
+  ASSERT_EQ( 3, count( output(), "ustimer " ));
+
+  ASSERT_EQ( Time::TimeUS( Time::TimeMS( 100 )), process.execute() );
+  ASSERT_EQ( 1, count( output(), "ustimer " ));
+}
+
+TEST_F( ProcessCommandTest, stamp_lines_when_they_arrive )
+{
+  // Two reads, the second with a batch and a line in it
+  hst->now = 1000;
+  send( "@1 timeus\n" );
+  hst->now = 2000;
+  send( "@2 timeus;@3 timeus\n@4 timeus\n" );
+
+  // Both are handled later.  Received is each line's read, not now
+  hst->now = 5000;
+  process.execute();
+  const std::string out = output();
+  ASSERT_EQ( 1, count( out, "@1 1000 5000 5000\n" ));
+  ASSERT_EQ( 1, count( out, "@2 2000 5000 5000\n" ));
+  ASSERT_EQ( 1, count( out, "@3 2000 5000 5000\n" ));
+  ASSERT_EQ( 1, count( out, "@4 2000 5000 5000\n" ));
+}
+
+TEST_F( ProcessCommandTest, stamp_a_line_when_it_ends )
+{
+  // The line isn't in until its newline is
+  hst->now = 1000;
+  send( "@1 tim" );
+  hst->now = 2000;
+  send( "eus\n@2 tim" );
+  hst->now = 3000;
+  process.execute();
+  ASSERT_EQ( 1, count( output(), "@1 2000 3000 3000\n" ));
+
+  hst->now = 4000;
+  send( "eus\n" );
+  hst->now = 5000;
+  process.execute();
+  ASSERT_EQ( 1, count( output(), "@2 4000 5000 5000\n" ));
+}
+
+TEST_F( ProcessCommandTest, stamp_more_reads_than_fit )
+{
+  // Reads that don't fit share the newest stamp that did.  They look
+  // older than they are, never newer
+  for ( unsigned int i = 0; i < 10; ++i ) 
+  {
+    hst->now = 1000 * ( i + 1 );
+    send( "@" + std::to_string( i ) + " timeus\n" );
+  }
+  hst->now = 20000;
+  process.setCommandBudget( 10 );
+  process.execute();
+  const std::string out = output();
+  ASSERT_EQ( 1, count( out, "@0 1000 20000 20000\n" ));
+  ASSERT_EQ( 1, count( out, "@7 8000 20000 20000\n" ));
+  ASSERT_EQ( 1, count( out, "@8 8000 20000 20000\n" ));
+  ASSERT_EQ( 1, count( out, "@9 8000 20000 20000\n" ));
+}
+
+} // end namespace Command
@@ -1,74 +1,122 @@
 #include <gtest/gtest.h>
 
-#include "../firmware_v1/util_profile.h"
+#include "../firmware_v2/util_profile.h"
 #include "test_mock_net.h"
 
 namespace Util {
 
-#ifdef TODO
-TEST( profile_should, and_and_report_properly )
+namespace {
+
+// Every sample lands in a bucket that contains it, the buckets tile the
+// range with no gaps, and no bucket is wider than 1/subBuckets of its start.
+template< class Bins >
+void checkLayout()
+{
+  for ( uint32_t sample = 0; sample < 2 * Bins::subBuckets; ++sample ) {
+    const size_t bin = Bins::binForSample( sample );
+    ASSERT_EQ( sample, Bins::binLowerBound( bin ));
+    ASSERT_EQ( sample, Bins::binUpperBound( bin ));
+  }
+
+  size_t lastBin = 0;
+  for ( uint32_t sample = 0; sample < ( 1u << Bins::maxBits ); sample += 1 + sample / 64 ) {
+    const size_t bin = Bins::binForSample( sample );
+    ASSERT_GE( bin, lastBin );
+    ASSERT_LT( bin, Bins::numBins );
+    ASSERT_LE( Bins::binLowerBound( bin ), sample );
+    ASSERT_GE( Bins::binUpperBound( bin ), sample );
+    const uint32_t width = Bins::binUpperBound( bin ) - Bins::binLowerBound( bin ) + 1;
+    if ( bin >= 2 * Bins::subBuckets ) {
+      ASSERT_LE( width * Bins::subBuckets, Bins::binLowerBound( bin ));
+    }
+    lastBin = bin;
+  }
+  for ( size_t bin = 1; bin < Bins::numBins; ++bin ) {
+    ASSERT_EQ( Bins::binUpperBound( bin - 1 ) + 1, Bins::binLowerBound( bin ));
+  }
+  ASSERT_EQ( Bins::numBins - 1, Bins::binForSample( 0xffffffffffull ));
+}
+
+} // end anonymous namespace
+
+TEST( profile_should, bound_the_relative_error )
+{
+  checkLayout< Profile::Bins >();
+  checkLayout< LogLinearBins< 2, 16 > >();
+}
+
+TEST( profile_should, keep_resolution_after_an_outlier )
 {
   Profile test("test");
-  test.addSample( Time::TimeUS( 10 ));
-  test.addSample( Time::TimeUS( 20 ));
-  test.addSample( Time::TimeUS( 20 ));
-  test.addSample( Time::TimeUS( 95 ));
-  test.addSample( Time::TimeUS( 430 ));
-
-  NetMockSimpleTimed sink;
-  test.reportHistogram( sink );
-
-  TimedStringEvents goldenNet = {
-    { 0, "Histogram for test" },
-    { 0, " 60  0uS  -> 23uS" },
-    { 0, "  0  24uS  -> 47uS" },
-    { 0, "  0  48uS  -> 71uS" },
-    { 0, " 20  72uS  -> 95uS" },
-    { 0, "  0  96uS  -> 119uS" },
-    { 0, "  0  120uS  -> 143uS" },
-    { 0, "  0  144uS  -> 167uS" },
-    { 0, "  0  168uS  -> 191uS" },
-    { 0, "  0  192uS  -> 215uS" },
-    { 0, "  0  216uS  -> 239uS" },
-    { 0, "  0  240uS  -> 263uS" },
-    { 0, "  0  264uS  -> 287uS" },
-    { 0, "  0  288uS  -> 311uS" },
-    { 0, "  0  312uS  -> 335uS" },
-    { 0, "  0  336uS  -> 359uS" },
-    { 0, "  0  360uS  -> 383uS" },
-    { 0, "  0  384uS  -> 407uS" },
-    { 0, " 20  408uS  -> 431uS" },
-    { 0, "  0  432uS  -> 455uS" },
-    { 0, "  0  456uS  -> 479uS" }
-  };
+  for ( unsigned int i = 0; i < 1000; ++i ) {
+    test.addSample( Time::TimeUS( 10 ));
+  }
+  test.addSample( Time::TimeUS( 5000 ));
 
-  ASSERT_EQ( goldenNet, sink.getOutput() );
+  // The old profile doubled its bucket size until 5000uS fit, so the 10uS
+  // samples came back as 63uS.
+  ASSERT_EQ( 10, test.percentile( 500 ).get() );
+  ASSERT_EQ( 10, test.percentile( 990 ).get() );
+  ASSERT_EQ( 5000, test.maxSample().get() );
+  ASSERT_EQ( 1001, test.numSamples() );
+  ASSERT_EQ( ( 1000 * 10 + 5000 ) / 1001, test.mean().get() );
+}
 
-  NetMockSimpleTimed sink2;
-  test.reportOneLiner( sink2 );
-  TimedStringEvents goldenNet2 = {
-    { 0, "test                 50% = 23uS   90% = 431uS   98% = 431uS   max = 431uS" }
-  };
-  ASSERT_EQ( goldenNet2, sink2.getOutput() );
+TEST( profile_should, report_percentiles )
+{
+  Profile test("test");
+  ASSERT_EQ( 0, test.percentile( 500 ).get() );
+  ASSERT_EQ( 0, test.mean().get() );
 
-  Profile empty("empty");
+  for ( unsigned int sample = 1; sample <= 1000; ++sample ) {
+    test.addSample( Time::TimeUS( sample ));
+  }
 
-  NetMockSimpleTimed sink3;
-  empty.reportOneLiner( sink3 );
-  TimedStringEvents goldenNet3 = {
-    { 0, "empty                No Samples" }
+  // Percentiles are the upper bound of their bucket, so they can be high
+  // by up to 12.5%, but never low.
+  auto check = []( unsigned int expected, Time::TimeUS actual ) {
+    ASSERT_GE( actual.get(), expected );
+    ASSERT_LE( actual.get(), expected + expected / 8 );
   };
-  ASSERT_EQ( goldenNet3, sink3.getOutput() );
+  check( 500, test.percentile( 500 ));
+  check( 900, test.percentile( 900 ));
+  check( 990, test.percentile( 990 ));
+  check( 999, test.percentile( 999 ));
+  ASSERT_EQ( 1000, test.percentile( 1000 ).get() );
+  ASSERT_EQ( 500, test.mean().get() );
 
-  NetMockSimpleTimed sink4;
-  empty.reportHistogram( sink4 );
-  TimedStringEvents goldenNet4 = {
-    { 0, "Histogram for empty" },
-    { 0, "  No Samples" }
-  };
-  ASSERT_EQ( goldenNet4, sink4.getOutput() );
+  test.reset();
+  ASSERT_EQ( 0, test.numSamples() );
+  ASSERT_EQ( 0, test.maxSample().get() );
+}
+
+TEST( profile_should, keep_percentiles_when_counts_fill_up )
+{
+  Profile test("test");
+  for ( unsigned int i = 0; i < 100000; ++i ) {
+    test.addSample( Time::TimeUS( 10 ));
+    if ( i % 10 == 0 ) {
+      test.addSample( Time::TimeUS( 1000 ));
+    }
+  }
+
+  // The 10uS bucket filled up and was halved, but 1 in 11 samples is still
+  // 1000uS
+  ASSERT_EQ( 10, test.percentile( 900 ).get() );
+  ASSERT_LE( 1000, test.percentile( 950 ).get() );
+  ASSERT_EQ( 110000, test.numSamples() );
+  ASSERT_EQ( ( 100000 * 10 + 10000 * 1000 ) / 110000, test.mean().get() );
+}
+
+TEST( profile_should, clamp_huge_samples )
+{
+  Profile test("test");
+  test.addSample( Time::TimeUS( 100 ));
+  test.addSample( Time::TimeUS( 60000000 ));
+
+  ASSERT_EQ( 60000000, test.percentile( 1000 ).get() );
+  ASSERT_EQ( 60000000, test.maxSample().get() );
 }
-#endif
 
 } // end Action namespace
 
@@ -0,0 +1,163 @@
+#include <gtest/gtest.h>
+
+#include <memory>
+
+#include "../firmware_v2/command_scheduler.h"
+#include "../firmware_v2/command_static_scheduler.h"
+#include "test_mock_debug.h"
+#include "test_mock_net.h"
+
+namespace Command {
+
+namespace {
+
+class ManualHST: public Time::HST
+{
+  public:
+
+  Time::DeviceTimeMS msSinceDeviceStart() override { return Time::DeviceTimeMS( now / 1000 ); }
+  Time::DeviceTimeUS usSinceDeviceStart() override { return Time::DeviceTimeUS( now ); }
+  Time::TimeUS execute() override { return Time::TimeUS( 0 ); }
+  const char* debugName() override { return "ManualHST"; }
+
+  unsigned long long now = 0;
+};
+
+// One client, always connected
+class OneClientNet: public NetInterface
+{
+  public:
+
+  NetConnection& get() override { return *connection; }
+  std::shared_ptr<NetConnection> getShared() override { return connection; }
+  Time::TimeUS execute() override { return Time::TimeUS( 0 ); }
+  const char* debugName() override { return "OneClientNet"; }
+
+  std::shared_ptr<NetMockSimpleConnection> connection = std::make_shared<NetMockSimpleConnection>();
+};
+
+// Runs every period, and counts the runs
+class PeriodicCommand: public Base
+{
+  public:
+
+  Time::TimeUS execute() override { ++calls; return period; }
+  const char* debugName() override { return "PeriodicCommand"; }
+
+  Time::TimeUS period{ 1000 };
+  unsigned int calls = 0;
+};
+
+// Execute until the scheduler asks for a delay.  Returns the number of
+// runs, including the one that asked for the delay.
+template< class SchedulerType >
+unsigned int runUntilCaughtUp( SchedulerType& scheduler, Time::TimeUS& delay )
+{
+  unsigned int runs = 1;
+  for ( delay = scheduler.execute(); delay.get() == 0 && runs < 100000; delay = scheduler.execute() ) {
+    ++runs;
+  }
+  return runs;
+}
+
+// Run a PeriodicCommand once on time, stall the clock for 9.5 periods,
+// and count the runs it takes the scheduler to catch up
+unsigned int runsAfterStall( const ScheduleOptions& options, Scheduler::QueueType queueType )
+{
+  auto hst = std::make_shared<ManualHST>();
+  auto command = std::make_shared<PeriodicCommand>();
+  Scheduler scheduler( std::make_shared<OneClientNet>(), nullptr,
+                       std::make_shared<DebugInterfaceIgnoreMock>(), hst,
+                       queueType );
+  scheduler.addCommand( command, options );
+
+  EXPECT_EQ( Time::TimeUS( 1000 ), scheduler.execute() );
+  hst->now = 10500;
+  Time::TimeUS delay( 0 );
+  const unsigned int runs = runUntilCaughtUp( scheduler, delay );
+
+  // Whatever the policy, the phase is kept
+  EXPECT_EQ( Time::TimeUS( 500 ), delay );
+  EXPECT_EQ( runs + 1, command->calls );
+  return runs;
+}
+
+} // end anonymous namespace
+
+TEST( next_start_time_should, leave_a_command_thats_on_time_alone )
+{
+  ScheduleOptions options;
+  unsigned int skipped = 0;
+  ASSERT_EQ( Time::DeviceTimeUS( 2000 ), nextStartTime( options,
+    Time::DeviceTimeUS( 1000 ), Time::TimeUS( 1000 ), Time::DeviceTimeUS( 1500 ), skipped ));
+  ASSERT_EQ( 0, skipped );
+}
+
+TEST( next_start_time_should, burst_two_periods_by_default )
+{
+  // 10 periods are due, at 1000 through 10000.  The last 2 are kept
+  ScheduleOptions options;
+  unsigned int skipped = 0;
+  ASSERT_EQ( Time::DeviceTimeUS( 9000 ), nextStartTime( options,
+    Time::DeviceTimeUS( 0 ), Time::TimeUS( 1000 ), Time::DeviceTimeUS( 10500 ), skipped ));
+  ASSERT_EQ( 8, skipped );
+}
+
+TEST( next_start_time_should, burst_everything_without_a_limit )
+{
+  ScheduleOptions options;
+  options.burstLimit = 0;
+  unsigned int skipped = 0;
+  ASSERT_EQ( Time::DeviceTimeUS( 1000 ), nextStartTime( options,
+    Time::DeviceTimeUS( 0 ), Time::TimeUS( 1000 ), Time::DeviceTimeUS( 10500 ), skipped ));
+  ASSERT_EQ( 0, skipped );
+}
+
+TEST( next_start_time_should, skip_to_the_next_period )
+{
+  ScheduleOptions options;
+  options.catchUp = CatchUp::Skip;
+  unsigned int skipped = 0;
+  ASSERT_EQ( Time::DeviceTimeUS( 11000 ), nextStartTime( options,
+    Time::DeviceTimeUS( 0 ), Time::TimeUS( 1000 ), Time::DeviceTimeUS( 10500 ), skipped ));
+  ASSERT_EQ( 10, skipped );
+}
+
+TEST( scheduler_should, bound_the_burst_after_a_stall )
+{
+  // The late run, then the 2 periods the default burst keeps
+  for ( auto queueType: { Scheduler::QueueType::Heap, Scheduler::QueueType::TimingWheel } )
+  {
+    ASSERT_EQ( 3, runsAfterStall( ScheduleOptions(), queueType ));
+  }
+}
+
+TEST( scheduler_should, burst_every_period_without_a_limit )
+{
+  ScheduleOptions options;
+  options.burstLimit = 0;
+  ASSERT_EQ( 10, runsAfterStall( options, Scheduler::QueueType::Heap ));
+}
+
+TEST( scheduler_should, skip_every_missed_period )
+{
+  ScheduleOptions options;
+  options.catchUp = CatchUp::Skip;
+  ASSERT_EQ( 1, runsAfterStall( options, Scheduler::QueueType::Heap ));
+}
+
+TEST( static_scheduler_should, bound_the_burst_the_same_way )
+{
+  auto hst = std::make_shared<ManualHST>();
+  PeriodicCommand command;
+  StaticScheduler< PeriodicCommand > scheduler( hst, command );
+
+  ASSERT_EQ( Time::TimeUS( 1000 ), scheduler.execute() );
+  hst->now = 10500;
+  Time::TimeUS delay( 0 );
+  ASSERT_EQ( 3, runUntilCaughtUp( scheduler, delay ));
+  ASSERT_EQ( Time::TimeUS( 500 ), delay );
+  ASSERT_EQ( 7, scheduler.getSkippedPeriods( 0 ));
+}
+
+} // end namespace Command
@@ -0,0 +1,85 @@
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+
+#include "../firmware_v2/util_spsc_pipe.h"
+
+namespace Util {
+
+TEST( spsc_pipe_should, push_and_pop_in_order )
+{
+  SpscPipe< int, 8 > pipe;
+  int value = -1;
+  ASSERT_FALSE( pipe.pop( value ));
+
+  for ( int i = 0; i < 7; ++i ) {
+    ASSERT_TRUE( pipe.push( i ));
+  }
+  // One slot always stays empty
+  ASSERT_FALSE( pipe.push( 7 ));
+  ASSERT_EQ( 7, pipe.available() );
+
+  for ( int golden = 0; golden < 7; ++golden ) {
+    ASSERT_TRUE( pipe.pop( value ));
+    ASSERT_EQ( golden, value );
+  }
+  ASSERT_FALSE( pipe.pop( value ));
+}
+
+TEST( spsc_pipe_should, do_block_writes_and_reads )
+{
+  SpscPipe< char, 16 > pipe;
+  char scratch[ 16 ];
+
+  // Move the indexes so the next write wraps
+  ASSERT_EQ( 10, pipe.write( "0123456789", 10 ));
+  ASSERT_EQ( 10, pipe.read( scratch, 16 ));
+
+  // Partial write - only 15 fit
+  ASSERT_EQ( 15, pipe.write( "abcdefghijklmnopqrst", 20 ));
+  ASSERT_EQ( 0, pipe.write( "x", 1 ));
+
+  ASSERT_EQ( 4, pipe.read( scratch, 4 ));
+  ASSERT_EQ( "abcd", std::string( scratch, 4 ));
+  ASSERT_EQ( 11, pipe.read( scratch, 16 ));
+  ASSERT_EQ( "efghijklmno", std::string( scratch, 11 ));
+  ASSERT_EQ( 0, pipe.available() );
+}
+
+TEST( spsc_pipe_should, pass_data_between_threads )
+{
+  SpscPipe< unsigned int, 64 > pipe;
+  constexpr unsigned int numElements = 20000;
+
+  std::thread producer( [&pipe]() {
+    for ( unsigned int i = 0; i < numElements; ) {
+      if ( pipe.push( i )) {
+        ++i;
+      }
+      else {
+        std::this_thread::yield();
+      }
+    }
+  });
+
+  // Everything arrives, once, in order.  Only count the mismatches here;
+  // asserting before the join would leave the producer running
+  unsigned int expected = 0;
+  unsigned int mismatches = 0;
+  while ( expected < numElements ) {
+    unsigned int value;
+    if ( pipe.pop( value )) {
+      mismatches += ( value != expected );
+      ++expected;
+    }
+    else {
+      std::this_thread::yield();
+    }
+  }
+  producer.join();
+  ASSERT_EQ( 0u, mismatches );
+  ASSERT_EQ( 0, pipe.available() );
+}
+
+} // end namespace Util
@@ -0,0 +1,126 @@
+#include <gtest/gtest.h>
+#include <queue>
+
+#include "../firmware_v2/util_timing_wheel.h"
+
+namespace Util {
+
+namespace {
+struct TestIndexTag {};
+using TestIndex = UrbanRobot::TypeSafeNumber< size_t, TestIndexTag >;
+using TestWheel = TimingWheel< TestIndex >;
+using TestEntry = TestWheel::value_type;
+using TestHeap = std::priority_queue< TestEntry, std::vector<TestEntry>, std::greater<TestEntry> >;
+}
+
+TEST( timing_wheel_should, break_ties_on_index )
+{
+  TestWheel wheel;
+
+  wheel.push( TestEntry( Time::DeviceTimeUS( 100 ), TestIndex( 3 )));
+  wheel.push( TestEntry( Time::DeviceTimeUS( 100 ), TestIndex( 1 )));
+  wheel.push( TestEntry( Time::DeviceTimeUS( 100 ), TestIndex( 2 )));
+  wheel.push( TestEntry( Time::DeviceTimeUS(  50 ), TestIndex( 4 )));
+
+  const std::vector<size_t> golden = { 4, 1, 2, 3 };
+  for ( size_t index : golden ) {
+    ASSERT_EQ( index, wheel.top().second.get() );
+    wheel.pop();
+  }
+  ASSERT_TRUE( wheel.empty() );
+}
+
+TEST( timing_wheel_should, handle_far_future_entries )
+{
+  TestWheel wheel;
+
+  // 2^40 us is past the top level and goes on the overflow list
+  const unsigned long long farAway = 1ull << 40;
+  wheel.push( TestEntry( Time::DeviceTimeUS( farAway ),     TestIndex( 0 )));
+  wheel.push( TestEntry( Time::DeviceTimeUS( 5000000 ),     TestIndex( 1 )));
+  wheel.push( TestEntry( Time::DeviceTimeUS( farAway + 1 ), TestIndex( 2 )));
+
+  ASSERT_EQ( 5000000, wheel.top().first.get() );
+  wheel.pop();
+  ASSERT_EQ( farAway, wheel.top().first.get() );
+  wheel.pop();
+  ASSERT_EQ( farAway + 1, wheel.top().first.get() );
+  wheel.pop();
+  ASSERT_TRUE( wheel.empty() );
+}
+
+TEST( timing_wheel_should, accept_pushes_earlier_than_a_cascaded_top )
+{
+  TestWheel wheel;
+
+  wheel.push( TestEntry( Time::DeviceTimeUS( 10000 ), TestIndex( 0 )));
+  // Cascades the wheel forward to 10000
+  ASSERT_EQ( 10000, wheel.top().first.get() );
+  // ... then go back in time
+  wheel.push( TestEntry( Time::DeviceTimeUS( 20 ), TestIndex( 1 )));
+  ASSERT_EQ( 20, wheel.top().first.get() );
+  wheel.pop();
+  ASSERT_EQ( 10000, wheel.top().first.get() );
+}
+
+TEST( timing_wheel_should, erase_entries_on_any_level )
+{
+  TestWheel wheel;
+
+  wheel.push( TestEntry( Time::DeviceTimeUS( 10 ),        TestIndex( 0 )));
+  wheel.push( TestEntry( Time::DeviceTimeUS( 10 ),        TestIndex( 1 )));
+  wheel.push( TestEntry( Time::DeviceTimeUS( 5000 ),      TestIndex( 2 )));
+  wheel.push( TestEntry( Time::DeviceTimeUS( 1ull << 40 ), TestIndex( 3 )));
+
+  ASSERT_TRUE( wheel.erase( TestIndex( 1 )));
+  ASSERT_TRUE( wheel.erase( TestIndex( 2 )));
+  ASSERT_TRUE( wheel.erase( TestIndex( 3 )));
+  ASSERT_FALSE( wheel.erase( TestIndex( 3 )));
+  ASSERT_FALSE( wheel.erase( TestIndex( 7 )));
+  ASSERT_EQ( 1, wheel.size() );
+
+  // Erased indexes can go back in
+  wheel.push( TestEntry( Time::DeviceTimeUS( 5 ), TestIndex( 2 )));
+  const std::vector<size_t> golden = { 2, 0 };
+  for ( size_t index : golden ) {
+    ASSERT_EQ( index, wheel.top().second.get() );
+    wheel.pop();
+  }
+  ASSERT_TRUE( wheel.empty() );
+}
+
+//
+// Run the wheel and a std::priority_queue side by side the way the
+// scheduler does (pop, push back later) and make sure they agree.
+//
+TEST( timing_wheel_should, match_a_priority_queue )
+{
+  TestWheel wheel;
+  TestHeap heap;
+  constexpr size_t numIndexes = 64;
+  unsigned int seed = 1;
+
+  for ( size_t i = 0; i < numIndexes; ++i ) {
+    const TestEntry entry( Time::DeviceTimeUS( i % 3 ), TestIndex( i ));
+    wheel.push( entry );
+    heap.push( entry );
+  }
+
+  for ( unsigned int iter = 0; iter < 100000; ++iter ) {
+    const TestEntry fromWheel = wheel.top();
+    ASSERT_EQ( heap.top(), fromWheel );
+    wheel.pop();
+    heap.pop();
+
+    // Delays from 0 to ~16 seconds, weighted towards short ones
+    seed = seed * 1103515245u + 12345u;
+    const unsigned int shift = ( seed >> 8 ) % 24;
+    const unsigned long long delay = ( seed >> 16 ) & (( 1u << shift ) - 1 );
+    const TestEntry next( fromWheel.first + delay, fromWheel.second );
+    wheel.push( next );
+    heap.push( next );
+  }
+  ASSERT_EQ( heap.size(), wheel.size() );
+}
+
+} // end namespace Util
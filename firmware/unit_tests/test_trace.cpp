@@ -0,0 +1,64 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "../firmware_v2/util_trace.h"
+
+namespace Util {
+
+namespace {
+TraceEvent makeEvent( uint16_t index )
+{
+  return TraceEvent{ index * 10u + 1, 1, 1, index };
+}
+}
+
+TEST( trace_buffer_should, keep_events_in_order )
+{
+  TraceBuffer< 4 > trace;
+  ASSERT_EQ( 0, trace.size() );
+
+  trace.add( makeEvent( 0 ));
+  trace.add( makeEvent( 1 ));
+  trace.add( makeEvent( 2 ));
+
+  ASSERT_EQ( 3, trace.size() );
+  for ( size_t i = 0; i < trace.size(); ++i ) {
+    ASSERT_EQ( i, trace.at( i ).index );
+    ASSERT_EQ( i * 10, trace.at( i ).planned() );
+    ASSERT_EQ( i * 10 + 2, trace.at( i ).end() );
+  }
+}
+
+TEST( trace_buffer_should, overwrite_the_oldest_events )
+{
+  TraceBuffer< 4 > trace;
+
+  for ( uint16_t index = 0; index < 10; ++index ) {
+    trace.add( makeEvent( index ));
+  }
+
+  // Should have the last 4 events, oldest first
+  ASSERT_EQ( 4, trace.size() );
+  const std::vector<uint16_t> golden = { 6, 7, 8, 9 };
+  for ( size_t i = 0; i < golden.size(); ++i ) {
+    ASSERT_EQ( golden[ i ], trace.at( i ).index );
+  }
+
+  trace.reset();
+  ASSERT_EQ( 0, trace.size() );
+}
+
+TEST( trace_buffer_should, keep_times_past_32_bits )
+{
+  // Three hours after start, a run that started 5uS early
+  const unsigned long long threeHours = 3ull * 60 * 60 * 1000000;
+  TraceBuffer< 4 > trace;
+  trace.add( TraceEvent{ threeHours, -5, 100, 2 } );
+
+  ASSERT_EQ( threeHours, trace.at( 0 ).start );
+  ASSERT_EQ( threeHours + 5, trace.at( 0 ).planned() );
+  ASSERT_EQ( threeHours + 100, trace.at( 0 ).end() );
+}
+
+} // end namespace Util
@@ -0,0 +1,65 @@
+#include <gtest/gtest.h>
+
+#include "../firmware_v2/util_windowed_profile.h"
+
+namespace Util {
+
+namespace {
+Time::DeviceTimeUS atSecond( double second )
+{
+  return Time::DeviceTimeUS( static_cast<unsigned long long>( second * 1000000 ));
+}
+}
+
+TEST( windowed_profile_should, report_recent_samples )
+{
+  WindowedProfile test;
+  ASSERT_EQ( 0, test.numSamples( atSecond( 0 )));
+  ASSERT_EQ( 0, test.percentile( atSecond( 0 ), 500 ).get() );
+
+  for ( unsigned int i = 0; i < 100; ++i ) {
+    test.addSample( atSecond( 0.5 ), Time::TimeUS( 10 ));
+  }
+  test.addSample( atSecond( 1.5 ), Time::TimeUS( 3000 ));
+
+  // 10uS is in the 10-11uS bucket
+  ASSERT_EQ( 101, test.numSamples( atSecond( 2 )));
+  ASSERT_EQ( 11, test.percentile( atSecond( 2 ), 500 ).get() );
+  ASSERT_EQ( 3000, test.percentile( atSecond( 2 ), 1000 ).get() );
+}
+
+TEST( windowed_profile_should, forget_old_samples )
+{
+  WindowedProfile test;
+
+  // A slow start, then 12 seconds of fast samples
+  test.addSample( atSecond( 0 ), Time::TimeUS( 5000 ));
+  for ( unsigned int second = 1; second <= 12; ++second ) {
+    test.addSample( atSecond( second ), Time::TimeUS( 20 ));
+  }
+
+  // Only the last 5 two second slices (4 to 13) are left
+  ASSERT_EQ( 9, test.numSamples( atSecond( 12.5 )));
+  ASSERT_EQ( 20, test.percentile( atSecond( 12.5 ), 1000 ).get() );
+
+  // Nothing was added since, so the window drains a slice at a time
+  ASSERT_EQ( 5, test.numSamples( atSecond( 17.5 )));
+  ASSERT_EQ( 5, test.numSamples( atSecond( 17.9 )));
+  ASSERT_EQ( 3, test.numSamples( atSecond( 18 )));
+  ASSERT_EQ( 0, test.numSamples( atSecond( 30 )));
+}
+
+TEST( windowed_profile_should, clamp_large_samples )
+{
+  WindowedProfile test;
+  test.addSample( atSecond( 0 ), Time::TimeUS( 100 ));
+  test.addSample( atSecond( 0 ), Time::TimeUS( 250000 ));
+
+  ASSERT_EQ( 250000, test.percentile( atSecond( 0 ), 1000 ).get() );
+  ASSERT_EQ( 2, test.numSamples( atSecond( 0 )));
+
+  test.reset();
+  ASSERT_EQ( 0, test.numSamples( atSecond( 0 )));
+}
+
+} // end namespace Util